@@ -0,0 +1,79 @@
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* memfd_create() */
+#endif
+#include "codemem.h"
+
+#include <errno.h>
+#include <string.h> /* memcpy() */
+#include <unistd.h> /* sysconf(_SC_PAGESIZE), ftruncate(), close() */
+#include <sys/mman.h> /* mmap(), memfd_create() */
+
+int CodeMemCreate(CodeMem *CM, size_t size)
+{
+  long sz = sysconf(_SC_PAGESIZE);
+  size = (size + (sz - 1)) & ~(sz - 1);
+  if (!size)
+    size = sz;
+
+  CM->fd = memfd_create("hellovm-code", MFD_CLOEXEC);
+  if (CM->fd < 0)
+    return errno;
+  if (ftruncate(CM->fd, size))
+    goto fail;
+
+  /* Reserve adjacent address ranges for both views, so that code in the
+  executable view can refer to data in the writable view by 32-bit
+  PC-relative offsets. */
+  CM->rw = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                -1, 0);
+  if (CM->rw == MAP_FAILED)
+    goto fail;
+  CM->rx = CM->rw + size;
+  if (mmap(CM->rw, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+           CM->fd, 0) == MAP_FAILED ||
+      mmap(CM->rx, size, PROT_READ | PROT_EXEC, MAP_SHARED | MAP_FIXED,
+           CM->fd, 0) == MAP_FAILED) {
+    int err = errno;
+    munmap(CM->rw, 2 * size);
+    errno = err;
+    goto fail;
+  }
+
+  CM->size = size;
+  CM->used = 0;
+  return 0;
+
+fail:
+  {
+    int err = errno;
+    close(CM->fd);
+    CM->fd = -1;
+    return err;
+  }
+}
+
+void *CodeMemInstall(CodeMem *CM, const void *code, size_t size)
+{
+  size_t offset = (CM->used + 15) & ~(size_t) 15;
+  if (offset > CM->size || CM->size - offset < size)
+    return NULL;
+  CM->used = offset + size;
+  CodeMemPatch(CM, CM->rx + offset, code, size);
+  return CM->rx + offset;
+}
+
+void CodeMemPatch(CodeMem *CM, void *addr, const void *code, size_t size)
+{
+  char *rx = (char*) addr;
+  memcpy(CM->rw + (rx - CM->rx), code, size);
+  /* A no-op on AMD64; elsewhere, the instruction cache must be told
+  about the write to the other view. */
+  __builtin___clear_cache(rx, rx + size);
+}
+
+void CodeMemDispose(CodeMem *CM)
+{
+  munmap(CM->rx, CM->size);
+  munmap(CM->rw, CM->size);
+  close(CM->fd);
+}
@@ -0,0 +1,46 @@
+#ifndef CODEMEM_H
+#define CODEMEM_H
+/* Code memory that is mapped twice from the same memfd: a writable view
+for installing or patching code, and an executable view for invoking it.
+No page is ever writable and executable at the same address, and
+installing or patching code never changes any page protection. */
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CodeMem
+{
+  /** the memfd */
+  int fd;
+  /** size of both mappings, in bytes (a multiple of the page size) */
+  size_t size;
+  /** number of bytes handed out by CodeMemInstall() */
+  size_t used;
+  /** the writable view */
+  char *rw;
+  /** the executable view, right after the writable view */
+  char *rx;
+} CodeMem;
+
+/** Create code memory of at least size bytes.
+@return 0 on success, or an errno value */
+int CodeMemCreate(CodeMem *CM, size_t size);
+
+/** Copy code into the next free 16-byte aligned location.
+@return address of the code in the executable view
+@retval NULL if there is not enough space */
+void *CodeMemInstall(CodeMem *CM, const void *code, size_t size);
+
+/** Overwrite previously installed code.
+@param addr  address in the executable view */
+void CodeMemPatch(CodeMem *CM, void *addr, const void *code, size_t size);
+
+/** Unmap both views and close the memfd. */
+void CodeMemDispose(CodeMem *CM);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
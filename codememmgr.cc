@@ -0,0 +1,136 @@
+#include "codememmgr.h"
+
+#include "llvm/Support/MathExtras.h"
+
+CodeMemManager::~CodeMemManager()
+{
+  for (Chunk &C : Chunks)
+    CodeMemDispose(&C.CM);
+}
+
+CodeMemManager::Chunk *CodeMemManager::create(size_t Size, size_t CodeSize)
+{
+  Chunk C;
+  if (CodeMemCreate(&C.CM, Size))
+    return nullptr;
+  C.Code = 0;
+  C.Cold = C.CM.used = CodeSize;
+  C.Top = C.CM.size;
+  Chunks.push_back(C);
+  return &Chunks.back();
+}
+
+void CodeMemManager::reserveAllocationSpace(uintptr_t CodeSize,
+                                            uint32_t CodeAlign,
+                                            uintptr_t RODataSize,
+                                            uint32_t RODataAlign,
+                                            uintptr_t RWDataSize,
+                                            uint32_t RWDataAlign)
+{
+  /* Allocate all sections of the object from one chunk, with the
+  read-only data right after the code. RuntimeDyld pads each size to
+  the alignment, so that Place::Code and Place::ColdCode will fit. */
+  const uintptr_t Code = llvm::alignTo(CodeSize, RODataAlign);
+  if (const uintptr_t Size = Code + RODataSize + RWDataSize)
+    create(Size + RWDataAlign, Code);
+}
+
+uint8_t *CodeMemManager::allocate(uintptr_t Size, unsigned Alignment,
+                                  Place Where, bool Exec)
+{
+  const size_t Align = std::max(Alignment, 1U);
+  Chunk *C = Chunks.empty() ? nullptr : &Chunks.back();
+  size_t Offset = 0;
+
+  for (int Attempt = 0; Attempt < 2; Attempt++) {
+    if (C) {
+      switch (Where) {
+      case Place::Code:
+        Offset = llvm::alignTo(C->Code, Align);
+        if (Offset <= C->Cold && C->Cold - Offset >= Size) {
+          C->Code = Offset + Size;
+          goto found;
+        }
+        break;
+      case Place::ColdCode:
+        if (C->Cold >= Size) {
+          Offset = llvm::alignDown(C->Cold - Size, Align);
+          if (Offset >= C->Code) {
+            C->Cold = Offset;
+            goto found;
+          }
+        }
+        break;
+      case Place::ROData:
+        Offset = llvm::alignTo(C->CM.used, Align);
+        if (Offset <= C->Top && C->Top - Offset >= Size) {
+          C->CM.used = Offset + Size;
+          goto found;
+        }
+        break;
+      case Place::Data:
+        if (C->Top >= Size) {
+          Offset = llvm::alignDown(C->Top - Size, Align);
+          if (Offset >= C->CM.used) {
+            C->Top = Offset;
+            goto found;
+          }
+        }
+      }
+    }
+    /* Reservation was not requested, or it was exceeded. Allocate the
+    section by itself, and keep allocating from the reserved chunk. */
+    if (Attempt)
+      return nullptr;
+    const bool IsCode = Where == Place::Code || Where == Place::ColdCode;
+    const bool Reserved = C != nullptr;
+    C = create(Size + Align, IsCode ? Size + Align : 0);
+    if (C && Reserved) {
+      std::swap(Chunks.back(), Chunks[Chunks.size() - 2]);
+      C = &Chunks[Chunks.size() - 2];
+    }
+  }
+
+  return nullptr;
+found:
+  uint8_t *Addr = reinterpret_cast<uint8_t*>(C->CM.rw + Offset);
+  if (Exec)
+    Pending.emplace_back(Addr, C->CM.rx + Offset);
+  return Addr;
+}
+
+uint8_t *CodeMemManager::allocateCodeSection(uintptr_t Size,
+                                             unsigned Alignment, unsigned,
+                                             llvm::StringRef)
+{
+  return allocate(Size, Alignment, Place::Code, true);
+}
+
+uint8_t *CodeMemManager::allocateDataSection(uintptr_t Size,
+                                             unsigned Alignment, unsigned,
+                                             llvm::StringRef SectionName,
+                                             bool IsReadOnly)
+{
+  /* RTDyldMemoryManager::registerEHFrames() registers the address in
+  the writable view. */
+  if (!IsReadOnly || SectionName == ".eh_frame")
+    return allocate(Size, Alignment, Place::Data, false);
+  return allocate(Size, Alignment, Place::ROData, true);
+}
+
+void CodeMemManager::notifyObjectLoaded(llvm::RuntimeDyld &RTDyld,
+                                        const llvm::object::ObjectFile &)
+{
+  for (const auto &P : Pending)
+    RTDyld.mapSectionAddress(P.first, reinterpret_cast<uint64_t>(P.second));
+  Pending.clear();
+}
+
+bool CodeMemManager::finalizeMemory(std::string *)
+{
+  /* A no-op on AMD64; elsewhere, the instruction cache must be told
+  about the writes to the other view. */
+  for (Chunk &C : Chunks)
+    __builtin___clear_cache(C.CM.rx, C.CM.rx + C.CM.size);
+  return false;
+}
@@ -0,0 +1,87 @@
+#ifndef CODEMEMMGR_H
+#define CODEMEMMGR_H
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+
+#include <vector>
+
+#include "codemem.h"
+
+/** A memory manager for RuntimeDyld (MCJIT or the ORCv2
+RTDyldObjectLinkingLayer) that allocates the sections of objects in
+CodeMem (see codemem.h). RuntimeDyld writes and relocates all sections
+through the writable view. Code and read-only data are remapped to the
+executable view by notifyObjectLoaded() before the relocations are
+applied, so that finalizeMemory() does not have to change any page
+protections. Writable data and .eh_frame are used through the
+writable view. Not thread-safe. */
+class CodeMemManager : public llvm::RTDyldMemoryManager
+{
+public:
+  CodeMemManager() = default;
+  CodeMemManager(const CodeMemManager &) = delete;
+  ~CodeMemManager() override;
+
+  bool needsToReserveAllocationSpace() override { return true; }
+  void reserveAllocationSpace(uintptr_t CodeSize, uint32_t CodeAlign,
+                              uintptr_t RODataSize, uint32_t RODataAlign,
+                              uintptr_t RWDataSize,
+                              uint32_t RWDataAlign) override;
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               llvm::StringRef SectionName) override;
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, llvm::StringRef SectionName,
+                               bool IsReadOnly) override;
+
+  using llvm::RTDyldMemoryManager::notifyObjectLoaded;
+  void notifyObjectLoaded(llvm::RuntimeDyld &RTDyld,
+                          const llvm::object::ObjectFile &Obj) override;
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+protected:
+  /** Where to allocate a section in the memory of an object, which is
+  laid out as: Code, ColdCode, ROData, free space, Data */
+  enum class Place
+  {
+    /** upwards from the start */
+    Code,
+    /** downwards from the end of the reserved code size */
+    ColdCode,
+    /** upwards from the end of the reserved code size */
+    ROData,
+    /** downwards from the end */
+    Data
+  };
+
+  /** Allocate memory for a section.
+  @param Exec    whether the section will be remapped to the executable view
+  @return the address in the writable view
+  @retval nullptr if the memory could not be allocated */
+  uint8_t *allocate(uintptr_t Size, unsigned Alignment, Place Where,
+                    bool Exec);
+
+private:
+  struct Chunk
+  {
+    /** the memory; CM.used is the end of Place::ROData */
+    CodeMem CM;
+    /** the end of Place::Code */
+    size_t Code;
+    /** the start of Place::ColdCode */
+    size_t Cold;
+    /** the start of Place::Data */
+    size_t Top;
+  };
+
+  /** Create a chunk of at least Size bytes.
+  @param CodeSize  the size reserved for Place::Code and Place::ColdCode */
+  Chunk *create(size_t Size, size_t CodeSize);
+
+  std::vector<Chunk> Chunks;
+  /** sections to be remapped by the next notifyObjectLoaded():
+  the addresses in the writable and the executable view */
+  std::vector<std::pair<uint8_t*, char*>> Pending;
+};
+#endif
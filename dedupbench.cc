@@ -0,0 +1,132 @@
+/* Deduplication benchmark: submit modules that are generated for a
+number of tenants, some of which are identical, to a ModuleRegistry.
+Each request keeps its module referenced until a window of later
+requests has been submitted. Reports the hit rate as well as the
+compilation time and object code size that were saved. */
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+#include "registry.h"
+#include "rss.h"
+
+#include <chrono>
+#include <cinttypes> /* PRIu64 */
+#include <cstdio> /* printf() */
+#include <cstdlib> /* atoi() */
+#include <cstring> /* strcmp() */
+#include <random>
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+/** Create a module with int tenantJ(int x) { return abs(x) * (2J+3) + J; }
+@param orc  whether to invoke abs() from the current process, which
+            requires the ORC path instead of the blob path */
+static std::unique_ptr<llvm::Module> createTenant(llvm::LLVMContext &C,
+                                                  unsigned j, bool orc)
+{
+  const std::string Name{"tenant" + std::to_string(j)};
+  /* The module identifier differs between requests, but it is ignored
+  by ModuleRegistry::getCanonicalHash(). */
+  static unsigned request;
+  auto M = std::make_unique<llvm::Module>
+    ("request" + std::to_string(request++), C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionType *FT = llvm::FunctionType::get(intType, {intType}, false);
+  llvm::Function *TheFunction =
+    llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name,
+                           M.get());
+  TheFunction->setDoesNotThrow();
+
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(C, "entry",
+                                                     TheFunction));
+  llvm::Value *x = TheFunction->arg_begin();
+  if (orc) {
+    /* Prevent the call from being replaced with llvm.abs. */
+    auto call = builder.CreateCall(M->getOrInsertFunction("abs", FT), x);
+    call->addFnAttr(llvm::Attribute::NoBuiltin);
+    x = call;
+  } else {
+    auto neg = builder.CreateICmpSLT(x, builder.getInt32(0));
+    x = builder.CreateSelect(neg, builder.CreateNeg(x), x);
+  }
+  x = builder.CreateMul(x, builder.getInt32(2 * j + 3));
+  builder.CreateRet(builder.CreateAdd(x, builder.getInt32(j)));
+  return M;
+}
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  int count = argc > 1 ? atoi(argv[1]) : 10000;
+  unsigned distinct = argc > 2 ? atoi(argv[2]) : 100;
+  int window = argc > 3 ? atoi(argv[3]) : 100;
+  bool orc = argc > 4 && !strcmp(argv[4], "orc");
+  if (!distinct)
+    distinct = 1;
+  if (window < 1)
+    window = 1;
+
+  auto L = Loader::Create();
+  if (!L) {
+    llvm::errs() << L.takeError() << '\n';
+    return 1;
+  }
+
+  ModuleRegistry R{**L};
+  std::vector<RegisteredModule*> live(window);
+  std::mt19937 rng;
+  llvm::LLVMContext C;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    RegisteredModule *&slot = live[i % window];
+    if (slot)
+      if (llvm::Error Err{R.release(slot)}) {
+        llvm::errs() << Err << '\n';
+        return 1;
+      }
+
+    const unsigned j = rng() % distinct;
+    llvm::Expected<RegisteredModule*> RM{R.acquire(createTenant(C, j, orc))};
+    if (!RM) {
+      llvm::errs() << RM.takeError() << '\n';
+      return 1;
+    }
+    slot = *RM;
+
+    const std::string Name{"tenant" + std::to_string(j)};
+    llvm::Expected<uint64_t> Addr{(*L)->lookup(Name)};
+    if (!Addr) {
+      llvm::errs() << Addr.takeError() << '\n';
+      return 1;
+    }
+    if (reinterpret_cast<int(*)(int)>(*Addr)(-1) != int(3 * j + 3)) {
+      llvm::errs() << "wrong result from " << Name << '\n';
+      return 1;
+    }
+  }
+  const double elapsed = std::chrono::duration<double>
+    (std::chrono::steady_clock::now() - start).count();
+
+  const ModuleRegistry::Stats &S = R.getStats();
+  printf("requests\thits\thit_rate\tloaded\tblob\torc\tbytes_saved\t"
+         "ms_saved\tus_per_request\trss_kb\n");
+  printf("%" PRIu64 "\t%" PRIu64 "\t%.3f\t%zu\t%u\t%u\t%" PRIu64
+         "\t%.0f\t%.1f\t%ld\n",
+         S.Requests, S.Hits, double(S.Hits) / S.Requests, R.size(),
+         (*L)->getLoaded(LoadPath::Blob), (*L)->getLoaded(LoadPath::ORC),
+         S.BytesSaved, S.TimeSaved * 1e3, elapsed * 1e6 / count, rss_kb());
+
+  for (RegisteredModule *RM : live)
+    if (RM)
+      if (llvm::Error Err{R.release(RM)}) {
+        llvm::errs() << Err << '\n';
+        return 1;
+      }
+  return 0;
+}
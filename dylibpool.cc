@@ -0,0 +1,29 @@
+#include "dylibpool.h"
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+
+llvm::orc::ResourceTrackerSP DylibPool::acquire()
+{
+  llvm::orc::JITDylib *JD;
+  if (!Free.empty()) {
+    JD = Free.back();
+    Free.pop_back();
+  } else {
+    JD = &ES.createBareJITDylib("<pool" + std::to_string(Created++) + ">");
+    /* The symbols that will be resolved from the current process will be
+    associated with the default tracker, and they will survive release(). */
+    JD->addGenerator
+      (cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess
+                (GP)));
+  }
+  return JD->createResourceTracker();
+}
+
+llvm::Error DylibPool::release(llvm::orc::ResourceTrackerSP RT)
+{
+  llvm::orc::JITDylib &JD = RT->getJITDylib();
+  if (llvm::Error Err{RT->remove()})
+    return Err;
+  Free.push_back(&JD);
+  return llvm::Error::success();
+}
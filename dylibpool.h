@@ -0,0 +1,34 @@
+#ifndef DYLIBPOOL_H
+#define DYLIBPOOL_H
+#include "llvm/ExecutionEngine/Orc/Core.h"
+
+/** A pool of JITDylibs that are emptied by removing a ResourceTracker
+and then reused, instead of being created for each compilation and
+removed by llvm::orc::ExecutionSession::removeJITDylib(), which is not
+available before LLVM 14. Not thread-safe. */
+class DylibPool
+{
+public:
+  /** @param GP  global prefix for DynamicLibrarySearchGenerator */
+  DylibPool(llvm::orc::ExecutionSession &ES, char GP) : ES(ES), GP(GP) {}
+
+  /** Acquire an empty JITDylib.
+  @return a tracker for everything that will be added to the JITDylib */
+  llvm::orc::ResourceTrackerSP acquire();
+
+  /** Remove everything that was added to a JITDylib and return
+  the JITDylib to the pool.
+  @param RT  the result of acquire() */
+  llvm::Error release(llvm::orc::ResourceTrackerSP RT);
+
+  /** @return the number of JITDylibs that have been created */
+  size_t size() const { return Created; }
+
+private:
+  llvm::orc::ExecutionSession &ES;
+  const char GP;
+  /** JITDylibs that are available for acquire() */
+  std::vector<llvm::orc::JITDylib*> Free;
+  size_t Created = 0;
+};
+#endif
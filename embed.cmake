@@ -0,0 +1,16 @@
+# Convert a binary file into a C array.
+# cmake -DINPUT=file.bc -DOUTPUT=file.c -DNAME=symbol -P embed.cmake
+FILE(READ ${INPUT} HEX HEX)
+STRING(LENGTH "${HEX}" LENGTH)
+MATH(EXPR SIZE "${LENGTH} / 2")
+STRING(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+STRING(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)"
+  "\\1\n  " BYTES "${BYTES}")
+STRING(STRIP "${BYTES}" BYTES)
+FILE(WRITE ${OUTPUT}
+  "/* Generated from ${INPUT} by embed.cmake */\n"
+  "#include <stddef.h>\n\n"
+  "/* The bitcode reader expects 32-bit aligned input. */\n"
+  "__attribute__((aligned(4)))\n"
+  "const unsigned char ${NAME}[] = {\n  ${BYTES}\n};\n"
+  "const size_t ${NAME}_size = ${SIZE};\n")
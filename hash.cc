@@ -0,0 +1,18 @@
+#include "hash.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+std::string getModuleHash(const llvm::Module &M)
+{
+  llvm::SmallVector<char, 0> Bitcode;
+  llvm::raw_svector_ostream OS(Bitcode);
+  llvm::WriteBitcodeToFile(M, OS);
+  return llvm::toHex(llvm::SHA1::hash
+                     (llvm::ArrayRef<uint8_t>
+                      (reinterpret_cast<const uint8_t*>(Bitcode.data()),
+                       Bitcode.size())), true);
+}
@@ -0,0 +1,9 @@
+#ifndef HASH_H
+#define HASH_H
+#include "llvm/IR/Module.h"
+
+#include <string>
+
+/** @return the SHA-1 hash of the bitcode of a module, in hexadecimal */
+std::string getModuleHash(const llvm::Module &M);
+#endif
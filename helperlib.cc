@@ -0,0 +1,58 @@
+#include "helperlib.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Linker/Linker.h"
+
+llvm::Error HelperLibrary::link(llvm::Module &M) const
+{
+  bool Needed = false;
+  for (const llvm::Function &F : M)
+    if (F.isDeclaration() && Hosts.count(F.getName())) {
+      Needed = true;
+      break;
+    }
+  if (!Needed)
+    return llvm::Error::success();
+
+  /* Only the functions that will be linked will be materialized. */
+  llvm::Expected<std::unique_ptr<llvm::Module>> H
+    {llvm::getLazyBitcodeModule(Bitcode, M.getContext())};
+  if (!H)
+    return H.takeError();
+  (*H)->setDataLayout(M.getDataLayout());
+  (*H)->setTargetTriple(M.getTargetTriple());
+
+  std::vector<std::string> Linked;
+  if (llvm::Linker::linkModules
+      (M, std::move(*H), llvm::Linker::LinkOnlyNeeded,
+       [&Linked](llvm::Module &, const llvm::StringSet<> &GVs) {
+         for (const auto &GV : GVs)
+           Linked.push_back(GV.getKey().str());
+       }))
+    return llvm::make_error<llvm::StringError>
+      ("cannot link helpers into " + M.getModuleIdentifier(),
+       llvm::inconvertibleErrorCode());
+
+  for (const std::string &Name : Linked)
+    if (llvm::Function *F = M.getFunction(Name)) {
+      if (Hosts.count(Name))
+        F->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+      else
+        /* Without a host definition, the body must not be discarded. */
+        F->setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+
+  return llvm::Error::success();
+}
+
+llvm::orc::SymbolMap
+HelperLibrary::getSymbols(llvm::orc::MangleAndInterner &Mangle) const
+{
+  llvm::orc::SymbolMap Symbols;
+  for (const auto &H : Hosts)
+    Symbols[Mangle(H.getKey())] =
+      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(H.getValue()),
+                               llvm::JITSymbolFlags::Exported |
+                               llvm::JITSymbolFlags::Callable);
+  return Symbols;
+}
@@ -0,0 +1,37 @@
+#ifndef HELPERLIB_H
+#define HELPERLIB_H
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+/** Host helper functions whose bitcode is available for inlining into
+generated code. Before optimization, link() copies the definitions of
+the helpers that a module invokes with available_externally linkage, so
+that the optimizer may inline them. Calls that are not inlined will be
+resolved to the host definitions, by getSymbols(). */
+class HelperLibrary
+{
+public:
+  /** @param Bitcode  the definitions of the helpers; must remain valid */
+  explicit HelperLibrary(llvm::MemoryBufferRef Bitcode) : Bitcode(Bitcode) {}
+
+  /** Register the host definition of a helper that is defined in the
+  bitcode. Only registered helpers will be linked. */
+  void add(llvm::StringRef Name, const void *Addr) { Hosts[Name] = Addr; }
+
+  /** Link the definitions of the registered helpers that a module refers
+  to, as available_externally. */
+  llvm::Error link(llvm::Module &M) const;
+
+  /** @return the host definitions of the registered helpers */
+  llvm::orc::SymbolMap getSymbols(llvm::orc::MangleAndInterner &Mangle)
+    const;
+
+private:
+  const llvm::MemoryBufferRef Bitcode;
+  /** the registered helpers */
+  llvm::StringMap<const void*> Hosts;
+};
+#endif
@@ -0,0 +1,21 @@
+#ifndef HELPERS_H
+#define HELPERS_H
+/* The host helper functions that are defined in helpers.ll */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t hellovm_mix(uint32_t x);
+int32_t hellovm_clamp(int32_t x, int32_t lo, int32_t hi);
+
+/** The bitcode of helpers.ll, which is embedded by embed.cmake */
+extern const unsigned char hellovm_helpers_bc[];
+extern const size_t hellovm_helpers_bc_size;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,25 @@
+; Host helper functions that generated code may invoke. This file is
+; compiled by llc into the host definitions and assembled by llvm-as into
+; the bitcode that is embedded for inlining (see helpers.h).
+
+; The MurmurHash3 32-bit finalizer
+define i32 @hellovm_mix(i32 %x) nounwind readnone {
+  %1 = lshr i32 %x, 16
+  %2 = xor i32 %x, %1
+  %3 = mul i32 %2, -2048144789
+  %4 = lshr i32 %3, 13
+  %5 = xor i32 %3, %4
+  %6 = mul i32 %5, -1028477387
+  %7 = lshr i32 %6, 16
+  %8 = xor i32 %6, %7
+  ret i32 %8
+}
+
+; x limited to the range [lo, hi]
+define i32 @hellovm_clamp(i32 %x, i32 %lo, i32 %hi) nounwind readnone {
+  %1 = icmp slt i32 %x, %lo
+  %2 = select i1 %1, i32 %lo, i32 %x
+  %3 = icmp sgt i32 %2, %hi
+  %4 = select i1 %3, i32 %hi, i32 %2
+  ret i32 %4
+}
@@ -0,0 +1,106 @@
+/* Measure the latency of installing code while other threads of the
+same process are busy. Changing page protections with mprotect() forces
+a TLB shootdown on every core that is running this process; writing
+through the writable view of a CodeMem does not. */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include "codemem.h"
+
+#include <pthread.h>
+#include <stdio.h> /* printf() */
+#include <stdlib.h> /* atoi() */
+#include <string.h> /* memcpy() */
+#include <time.h> /* clock_gettime() */
+#include <unistd.h> /* sysconf(_SC_PAGESIZE) */
+#include <sys/mman.h> /* mmap(), mprotect() */
+
+#define MAX_THREADS 32
+
+static volatile int stop;
+
+static void *busy(void *arg)
+{
+  volatile size_t *counter = arg;
+  while (!stop)
+    ++*counter;
+  return NULL;
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** Install code by toggling the protection of an anonymous page,
+like the blob loader used to do. */
+static double bench_mprotect(char *page, size_t pagesize,
+                             const char *code, size_t size, int count)
+{
+  double start = now();
+  for (int i = 0; i < count; i++) {
+    mprotect(page, pagesize, PROT_READ | PROT_WRITE);
+    memcpy(page, code, size);
+    mprotect(page, pagesize, PROT_READ | PROT_EXEC);
+    (void) *(volatile char*) page;
+  }
+  return (now() - start) / count;
+}
+
+/** Install code through the writable view of a CodeMem. */
+static double bench_codemem(CodeMem *CM, const char *code, size_t size,
+                            int count)
+{
+  double start = now();
+  for (int i = 0; i < count; i++) {
+    CM->used = 0;
+    char *rx = CodeMemInstall(CM, code, size);
+    (void) *(volatile char*) rx;
+  }
+  return (now() - start) / count;
+}
+
+int main(int argc, char **argv)
+{
+  int count = argc > 1 ? atoi(argv[1]) : 10000;
+  long pagesize = sysconf(_SC_PAGESIZE);
+  static char code[64];
+  static size_t counters[MAX_THREADS * 8];
+  pthread_t threads[MAX_THREADS];
+
+  char *page = mmap(NULL, pagesize, PROT_READ | PROT_EXEC,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED)
+    return 2;
+  CodeMem CM;
+  if (CodeMemCreate(&CM, pagesize))
+    return 2;
+
+  memset(code, 0xc3, sizeof code);
+
+  printf("threads\tmprotect_ns\tcodemem_ns\n");
+
+  for (int n = 1; n <= MAX_THREADS; n *= 2) {
+    stop = 0;
+    int started;
+    for (started = 0; started < n; started++)
+      if (pthread_create(&threads[started], NULL, busy,
+                         &counters[started * 8]))
+        break;
+
+    double mp = bench_mprotect(page, pagesize, code, sizeof code, count);
+    double cm = bench_codemem(&CM, code, sizeof code, count);
+
+    stop = 1;
+    while (started--)
+      pthread_join(threads[started], NULL);
+
+    printf("%d\t%.0f\t%.0f\n", n, mp, cm);
+  }
+
+  CodeMemDispose(&CM);
+  munmap(page, pagesize);
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#ifndef NDEBUG
+# include "llvm/IR/Verifier.h"
+#endif
+#include "llvm/Support/TargetSelect.h"
+#include "loader.h"
+
+#include <cstdio> /* printf(), puts() */
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+#if LLVM_VERSION_MAJOR < 10
+namespace llvm { using Align = int; }
+#endif
+
+/** Create the self-contained function of lo.cc */
+static std::unique_ptr<llvm::Module> createBoo(llvm::LLVMContext &C)
+{
+  auto M = std::make_unique<llvm::Module>("boo", C);
+  const auto stringType = llvm::Type::getInt8PtrTy(C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionType *PutsType =
+    llvm::FunctionType::get(intType, {stringType}, false);
+  llvm::FunctionType *FT =
+    llvm::FunctionType::get(intType,
+                            {stringType, PutsType->getPointerTo(), stringType},
+                            false);
+  llvm::Function *TheFunction =
+    llvm::Function::Create(FT, llvm::Function::ExternalLinkage,
+                           "boo", M.get());
+  TheFunction->setDoesNotThrow();
+
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(C, "entry",
+                                                     TheFunction));
+  auto Str = TheFunction->arg_begin();
+  auto F = Str;
+  llvm::FunctionCallee FC{PutsType, ++F};
+  auto c1 = builder.CreateCall(FC, Str);
+  auto c2 = builder.CreateCall(FC, ++F);
+  builder.CreateRet(builder.CreateAdd(c1, c2));
+  assert(!llvm::verifyFunction(*TheFunction, &llvm::errs()));
+  return M;
+}
+
+/** Create a function that refers to the global "greetings" and
+directly invokes the external function puts() */
+static std::unique_ptr<llvm::Module> createGreet(llvm::LLVMContext &C)
+{
+  auto M = std::make_unique<llvm::Module>("greet", C);
+  const auto stringType = llvm::Type::getInt8PtrTy(C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionCallee Puts =
+    M->getOrInsertFunction("puts",
+                           llvm::FunctionType::get(intType, {stringType},
+                                                   false));
+  llvm::FunctionType *FT =
+    llvm::FunctionType::get(intType, {stringType, intType}, false);
+  llvm::Function *TheFunction =
+    llvm::Function::Create(FT, llvm::Function::ExternalLinkage,
+                           "greet", M.get());
+  TheFunction->setDoesNotThrow();
+
+  const auto world =
+    llvm::ConstantDataArray::getString(C, llvm::StringRef{"world", 6},
+                                       false);
+  const auto all =
+    llvm::ConstantDataArray::getString(C, llvm::StringRef{"all\0\0", 6},
+                                       false);
+  const auto greetings =
+    llvm::ConstantArray::get(llvm::ArrayType::get(world->getType(), 2),
+                             {world, all});
+  auto GV = new llvm::GlobalVariable(*M, greetings->getType(), true,
+                                     llvm::GlobalValue::ExternalLinkage,
+                                     greetings, "greetings");
+  GV->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Local);
+  GV->setAlignment(llvm::Align(1));
+
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(C, "entry",
+                                                     TheFunction));
+  auto Str = TheFunction->arg_begin();
+  auto c1 = builder.CreateCall(Puts, Str);
+  auto c2a = builder.CreateInBoundsGEP(GV->getValueType(), GV,
+                                       {builder.getInt32(0), Str + 1});
+  auto c2 = builder.CreateCall(Puts, builder.CreateBitCast(c2a, stringType));
+  builder.CreateRet(builder.CreateAdd(c1, c2));
+  assert(!llvm::verifyFunction(*TheFunction, &llvm::errs()));
+  return M;
+}
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto L = Loader::Create();
+  if (!L) {
+    llvm::errs() << L.takeError();
+    return 1;
+  }
+
+  llvm::LLVMContext C;
+  std::vector<LoadedModule*> Modules;
+
+  for (auto create : {createBoo, createGreet}) {
+    auto M = create(C);
+    const std::string Name = M->getName().str();
+    llvm::Expected<LoadedModule*> LM{(*L)->add(std::move(M))};
+    if (!LM) {
+      llvm::errs() << LM.takeError() << '\n';
+      return 1;
+    }
+    printf("%s: %s\n", Name.c_str(), getLoadPathName((*LM)->Path));
+    Modules.push_back(*LM);
+  }
+
+  uint64_t Addrs[2];
+  if (llvm::Error Err{(*L)->lookup({"boo", "greet"}, Addrs)}) {
+    llvm::errs() << Err << '\n';
+    return 1;
+  }
+  if (!Addrs[0] || !Addrs[1]) {
+    llvm::errs() << "symbol not found\n";
+    return 1;
+  }
+
+  typedef int (*callback)(const char*);
+  auto boo =
+    reinterpret_cast<int(*)(const char *, callback, const char *)>(Addrs[0]);
+  auto greet = reinterpret_cast<int(*)(const char *, unsigned)>(Addrs[1]);
+  int ret = boo("hello", puts, "world") + greet("goodbye", 1);
+
+  for (LoadedModule *LM : Modules)
+    if (llvm::Error Err{(*L)->remove(LM)}) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+  return ret;
+}
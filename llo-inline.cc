@@ -0,0 +1,140 @@
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#ifndef NDEBUG
+# include "llvm/IR/Verifier.h"
+#endif
+#include "llvm/Support/TargetSelect.h"
+#include "helperlib.h"
+#include "helpers.h"
+#include "loader.h"
+
+#include <chrono>
+#include <cstdio> /* printf() */
+#include <cstdlib> /* atoi() */
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+/** Create int boo(int n)
+{ int s = 0; for (int i = 0; i < n; i++)
+  s += hellovm_clamp(hellovm_mix(i), -1000, 1000); return s; }
+@param Name  the name of the function */
+static std::unique_ptr<llvm::Module> createBoo(llvm::LLVMContext &C,
+                                               const std::string &Name)
+{
+  auto M = std::make_unique<llvm::Module>(Name, C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionCallee Mix =
+    M->getOrInsertFunction("hellovm_mix",
+                           llvm::FunctionType::get(intType, {intType},
+                                                   false));
+  llvm::FunctionCallee Clamp =
+    M->getOrInsertFunction("hellovm_clamp",
+                           llvm::FunctionType::get(intType,
+                                                   {intType, intType,
+                                                    intType}, false));
+  llvm::Function *TheFunction =
+    llvm::Function::Create(llvm::FunctionType::get(intType, {intType},
+                                                   false),
+                           llvm::Function::ExternalLinkage, Name, M.get());
+  TheFunction->setDoesNotThrow();
+
+  auto Entry = llvm::BasicBlock::Create(C, "entry", TheFunction);
+  auto Loop = llvm::BasicBlock::Create(C, "loop", TheFunction);
+  auto Exit = llvm::BasicBlock::Create(C, "exit", TheFunction);
+  auto N = TheFunction->arg_begin();
+
+  llvm::IRBuilder<> builder(Entry);
+  builder.CreateCondBr(builder.CreateICmpSGT(N, builder.getInt32(0)),
+                       Loop, Exit);
+  builder.SetInsertPoint(Loop);
+  auto i = builder.CreatePHI(intType, 2);
+  auto s = builder.CreatePHI(intType, 2);
+  auto m = builder.CreateCall(Mix, i);
+  auto c = builder.CreateCall(Clamp, {m, builder.getInt32(-1000),
+                                      builder.getInt32(1000)});
+  auto s1 = builder.CreateAdd(s, c);
+  auto i1 = builder.CreateAdd(i, builder.getInt32(1));
+  i->addIncoming(builder.getInt32(0), Entry);
+  i->addIncoming(i1, Loop);
+  s->addIncoming(builder.getInt32(0), Entry);
+  s->addIncoming(s1, Loop);
+  builder.CreateCondBr(builder.CreateICmpSLT(i1, N), Loop, Exit);
+  builder.SetInsertPoint(Exit);
+  auto r = builder.CreatePHI(intType, 2);
+  r->addIncoming(builder.getInt32(0), Entry);
+  r->addIncoming(s1, Loop);
+  builder.CreateRet(r);
+  assert(!llvm::verifyFunction(*TheFunction, &llvm::errs()));
+  return M;
+}
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  int count = argc > 1 ? atoi(argv[1]) : 10000000;
+
+  auto L = Loader::Create();
+  if (!L) {
+    llvm::errs() << L.takeError();
+    return 1;
+  }
+
+  HelperLibrary H{llvm::MemoryBufferRef
+                  {llvm::StringRef{reinterpret_cast<const char*>
+                                   (hellovm_helpers_bc),
+                                   hellovm_helpers_bc_size},
+                   "helpers.bc"}};
+  H.add("hellovm_mix", reinterpret_cast<const void*>(hellovm_mix));
+  H.add("hellovm_clamp", reinterpret_cast<const void*>(hellovm_clamp));
+
+  {
+    llvm::orc::MangleAndInterner Mangle{(*L)->getExecutionSession(),
+                                        (*L)->getDataLayout()};
+    if (llvm::Error Err{(*L)->getMainJITDylib().define
+                        (llvm::orc::absoluteSymbols(H.getSymbols(Mangle)))}) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+  }
+
+  llvm::LLVMContext C;
+  int results[2];
+
+  for (bool inline_helpers : {false, true}) {
+    const std::string Name{inline_helpers ? "boo_inline" : "boo_call"};
+    auto M = createBoo(C, Name);
+    if (inline_helpers)
+      if (llvm::Error Err{H.link(*M)}) {
+        llvm::errs() << Err << '\n';
+        return 1;
+      }
+
+    llvm::Expected<LoadedModule*> LM{(*L)->add(std::move(M))};
+    if (!LM) {
+      llvm::errs() << LM.takeError() << '\n';
+      return 1;
+    }
+    llvm::Expected<uint64_t> Addr{(*L)->lookup(Name)};
+    if (!Addr) {
+      llvm::errs() << Addr.takeError() << '\n';
+      return 1;
+    }
+
+    auto boo = reinterpret_cast<int(*)(int)>(*Addr);
+    auto start = std::chrono::steady_clock::now();
+    results[inline_helpers] = boo(count);
+    std::chrono::duration<double, std::nano> ns
+      {std::chrono::steady_clock::now() - start};
+    printf("%s: %s, %.2f ns per iteration, result %d\n", Name.c_str(),
+           getLoadPathName((*LM)->Path), ns.count() / count,
+           results[inline_helpers]);
+  }
+
+  return results[0] != results[1];
+}
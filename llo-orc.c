@@ -11,7 +11,7 @@
 #include "orc.h"
 
 #include <stdio.h> /* puts(), fopen() */
-#include <stdlib.h> /* atoi() */
+#include <stdlib.h> /* atoi(), getenv() */
 
 #define FALSE 0
 #define TRUE 1
@@ -20,6 +20,8 @@ int main(int argc, char **argv)
 {
   LLVMInitializeNativeTarget();
   LLVMInitializeNativeAsmPrinter();
+  if (getenv("HELLOVM_PERF"))
+    PerfEnable();
 
   LLVMOrcLLJITRef Jit = NULL;
   LLVMOrcThreadSafeContextRef TSC = LLVMOrcCreateNewThreadSafeContext();
@@ -46,7 +48,8 @@ int main(int argc, char **argv)
 
   int count = argc > 1 ? atoi(argv[1]) : 1;
 
-loop:
+  /* The JITDylib is reused by all iterations. Everything that is added
+  to it in an iteration will be removed via a ResourceTracker. */
   LLVMOrcJITDylibRef JD = LLVMOrcExecutionSessionCreateBareJITDylib
     (LLVMOrcLLJITGetExecutionSession(Jit), "<main>");
 
@@ -60,6 +63,10 @@ loop:
     LLVMOrcJITDylibAddGenerator(JD, DG);
   }
 
+  LLVMOrcResourceTrackerRef RT;
+loop:
+  RT = LLVMOrcJITDylibCreateResourceTracker(JD);
+
   {
     LLVMOrcThreadSafeModuleRef TSM;
     LLVMContextRef C = LLVMOrcThreadSafeContextGetContext(TSC);
@@ -119,14 +126,28 @@ loop:
 
     assert(!LLVMVerifyFunction(TheFunction, LLVMPrintMessageAction));
     TSM = LLVMOrcCreateNewThreadSafeModule(M, TSC);
-    if ((Err = LLVMOrcLLJITAddLLVMIRModule(Jit, JD, TSM)))
+    if ((Err = LLVMOrcLLJITAddLLVMIRModuleWithRT(Jit, RT, TSM))) {
+      LLVMOrcReleaseResourceTracker(RT);
       goto err_exit;
+    }
   }
 
-  LLVMOrcJITTargetAddress booAddr, greetingsAddr;
-  if ((Err = LLVM_Lookup(Jit, JD, &booAddr, "boo")) ||
-      (Err = LLVM_Lookup(Jit, JD, &greetingsAddr, "greetings")))
+  static const char *const names[2] = {"boo", "greetings"};
+  LLVMOrcJITTargetAddress addrs[2];
+  if ((Err = LLVM_LookupBatch(Jit, JD, addrs, names, 2))) {
+    LLVMOrcReleaseResourceTracker(RT);
     goto err_exit;
+  }
+  if (!addrs[0] || !addrs[1]) {
+    fprintf(stderr, "Error: symbol not found: %s\n", names[addrs[0] != 0]);
+    LLVMOrcReleaseResourceTracker(RT);
+    LLVMOrcDisposeThreadSafeContext(TSC);
+    LLVMOrcDisposeLLJIT(Jit);
+    return 1;
+  }
+  LLVMOrcJITTargetAddress booAddr = addrs[0], greetingsAddr = addrs[1];
+  /* Each iteration replaces the code; the counters will be kept. */
+  PerfEntry *booPerf = PerfEnabled() ? PerfRegister("boo", booAddr) : NULL;
 
   printf("boo=%" PRIx64 ", greetings=%" PRIx64 "\n", booAddr, greetingsAddr);
 #if 0 // TODO: How to determine the length of the code?
@@ -146,13 +167,19 @@ loop:
   typedef int (*callback)(const char*);
   int (*boo) (const char *, callback, unsigned) =
     ((int (*)(const char *, callback, unsigned)) booAddr);
+  PerfReading start;
+  PerfStart(&start);
   int ret = boo("hello", puts, 0) + boo("goodbye", puts, 1);
-#if LLVM_VERSION_MAJOR >= 14
-  LLVM_Remove(LLVMOrcLLJITGetExecutionSession(Jit), JD);
-#endif
+  PerfStop(booPerf, &start);
+  Err = LLVMOrcResourceTrackerRemove(RT);
+  LLVMOrcReleaseResourceTracker(RT);
+  if (Err)
+    goto err_exit;
 
   if (--count > 0)
     goto loop;
+  if (PerfEnabled())
+    PerfDump(stderr);
   LLVMOrcDisposeThreadSafeContext(TSC);
   LLVMOrcDisposeLLJIT(Jit);
   return ret;
@@ -17,6 +17,7 @@
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "dylibpool.h"
 
 #if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
 namespace std { using llvm::make_unique; }
@@ -52,13 +53,12 @@ int main(int argc, char **argv)
     {*ES, ObjectLayer,
      std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(JTMB))};
 
+  DylibPool Pool{*ES, GP};
   int count = argc > 1 ? atoi(argv[1]) : 1;
 
 loop:
-  llvm::orc::JITDylib &JD = ES->createBareJITDylib("<main>");
-  JD.addGenerator
-    (cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess
-              (GP)));
+  llvm::orc::ResourceTrackerSP RT{Pool.acquire()};
+  llvm::orc::JITDylib &JD = RT->getJITDylib();
 
   auto C = std::make_unique<llvm::LLVMContext>();
   auto M = std::make_unique<llvm::Module>("heLLoVM", *C);
@@ -112,27 +112,23 @@ loop:
 
   if (llvm::Error Err
       {CompileLayer.add
-       (JD.getDefaultResourceTracker(),
-        llvm::orc::ThreadSafeModule(std::move(M), std::move(C)))}) {
+       (RT, llvm::orc::ThreadSafeModule(std::move(M), std::move(C)))}) {
     llvm::logAllUnhandledErrors(std::move(Err), llvm::errs(), "");
     return 1;
   }
 
-  llvm::Expected<llvm::JITEvaluatedSymbol> booSym
-    {ES->lookup({&JD}, (*Mangle)("boo"))};
-  if (!booSym) {
-    llvm::errs() << booSym.takeError() << '\n';
-    return 1;
-  }
-  llvm::Expected<llvm::JITEvaluatedSymbol> greetingsSym
-    {ES->lookup({&JD}, (*Mangle)("greetings"))};
-  if (!greetingsSym) {
-    llvm::errs() << greetingsSym.takeError() << '\n';
+  const llvm::orc::SymbolStringPtr booName{(*Mangle)("boo")};
+  const llvm::orc::SymbolStringPtr greetingsName{(*Mangle)("greetings")};
+  llvm::Expected<llvm::orc::SymbolMap> Syms
+    {ES->lookup(llvm::orc::makeJITDylibSearchOrder(&JD),
+                llvm::orc::SymbolLookupSet({booName, greetingsName}))};
+  if (!Syms) {
+    llvm::errs() << Syms.takeError() << '\n';
     return 1;
   }
 
-  uint64_t f = booSym->getAddress();
-  uint64_t gv = greetingsSym->getAddress();
+  uint64_t f = (*Syms)[booName].getAddress();
+  uint64_t gv = (*Syms)[greetingsName].getAddress();
 
   printf("boo=%" PRIx64 ", greetings=%" PRIx64 "\n", f, gv);
 #if 0 // TODO: How to determine the length of the code?
@@ -150,13 +146,15 @@ loop:
   auto boo =
     reinterpret_cast<int(*)(const char *, callback, unsigned)>(f);
   int ret = boo("hello ", puts, 0) + boo("goodbye ", puts, 1);
-#if LLVM_VERSION_MAJOR >= 14
-  if (llvm::Error Err{ES->removeJITDylib(JD)}) {
+  if (llvm::Error Err{Pool.release(std::move(RT))}) {
     llvm::logAllUnhandledErrors(std::move(Err), llvm::errs(), "");
     return 1;
   }
-#endif
   if (--count > 0)
     goto loop;
+  if (llvm::Error Err{ES->endSession()}) {
+    llvm::logAllUnhandledErrors(std::move(Err), llvm::errs(), "");
+    return 1;
+  }
   return ret;
 }
@@ -0,0 +1,131 @@
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#ifndef NDEBUG
+# include "llvm/IR/Verifier.h"
+#endif
+#include "llvm/Support/TargetSelect.h"
+#include "loader.h"
+#include "profile.h"
+
+#include <cinttypes> /* PRIu64 */
+#include <cstdio> /* printf(), puts() */
+#include <cstdlib> /* atoi() */
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  const char *dir = argc > 1 ? argv[1] : ".";
+  int count = argc > 2 ? atoi(argv[2]) : 1000;
+
+  auto L = Loader::Create();
+  if (!L) {
+    llvm::errs() << L.takeError();
+    return 1;
+  }
+
+  llvm::LLVMContext C;
+  auto M = std::make_unique<llvm::Module>("heLLoPGO", C);
+
+  {
+    /* int boo(unsigned n, int (*puts)(const char*), const char *s)
+    { return n % 100 ? n * 3 : puts(s); } */
+    const auto stringType = llvm::Type::getInt8PtrTy(C);
+    const auto intType = llvm::Type::getInt32Ty(C);
+    llvm::FunctionType *PutsType =
+      llvm::FunctionType::get(intType, {stringType}, false);
+    llvm::FunctionType *FT =
+      llvm::FunctionType::get(intType,
+                              {intType, PutsType->getPointerTo(), stringType},
+                              false);
+    llvm::Function *TheFunction =
+      llvm::Function::Create(FT, llvm::Function::ExternalLinkage,
+                             "boo", M.get());
+    /* Declare puts(), so that applyProfile() can promote the indirect
+    call to a direct call. */
+    llvm::Function::Create(PutsType, llvm::Function::ExternalLinkage,
+                           "puts", M.get());
+    TheFunction->setDoesNotThrow();
+
+    auto Entry = llvm::BasicBlock::Create(C, "entry", TheFunction);
+    auto Rare = llvm::BasicBlock::Create(C, "rare", TheFunction);
+    auto Common = llvm::BasicBlock::Create(C, "common", TheFunction);
+    auto N = TheFunction->arg_begin();
+    auto F = N + 1;
+    auto S = N + 2;
+
+    llvm::IRBuilder<> builder(Entry);
+    builder.CreateCondBr(builder.CreateICmpEQ
+                         (builder.CreateURem(N, builder.getInt32(100)),
+                          builder.getInt32(0)), Rare, Common);
+    builder.SetInsertPoint(Rare);
+    builder.CreateRet(builder.CreateCall(llvm::FunctionCallee{PutsType, F},
+                                         S));
+    builder.SetInsertPoint(Common);
+    builder.CreateRet(builder.CreateMul(N, builder.getInt32(3)));
+    assert(!llvm::verifyFunction(*TheFunction, &llvm::errs()));
+  }
+
+  const std::string Hash{getModuleHash(*M)};
+  llvm::Optional<ProfileCounters> P;
+
+  if (llvm::Expected<std::vector<uint64_t>> Profile{loadProfile(dir, Hash)}) {
+    if (llvm::Error Err{applyProfile(*M, *Profile)}) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+    for (const llvm::Function &Fn : *M)
+      if (!Fn.isDeclaration())
+        printf("%s: profiled, entry count %" PRIu64 "%s%s\n",
+               Fn.getName().str().c_str(), Fn.getEntryCount()->getCount(),
+               Fn.hasFnAttribute(llvm::Attribute::Hot) ? ", hot" : "",
+               Fn.hasFnAttribute(llvm::Attribute::Cold) ? ", cold" : "");
+    if (!M->getFunction("puts")->use_empty())
+      puts("boo: indirect call promoted to puts");
+  } else {
+    llvm::consumeError(Profile.takeError());
+    P = instrumentProfile(*M, Hash);
+    printf("%s: instrumented, %zu counters\n", Hash.c_str(), P->Size);
+  }
+
+  llvm::Expected<LoadedModule*> LM{(*L)->add(std::move(M))};
+  if (!LM) {
+    llvm::errs() << LM.takeError() << '\n';
+    return 1;
+  }
+
+  llvm::Expected<uint64_t> booAddr{(*L)->lookup("boo")};
+  if (!booAddr) {
+    llvm::errs() << booAddr.takeError() << '\n';
+    return 1;
+  }
+
+  typedef int (*callback)(const char*);
+  auto boo =
+    reinterpret_cast<int(*)(unsigned, callback, const char *)>(*booAddr);
+  int ret = 0;
+  for (int i = 0; i < count; i++)
+    ret += boo(i, puts, "hello");
+
+  if (P) {
+    llvm::Expected<uint64_t> countersAddr{(*L)->lookup(P->Name)};
+    if (!countersAddr) {
+      llvm::errs() << countersAddr.takeError() << '\n';
+      return 1;
+    }
+    if (llvm::Error Err{saveProfile(dir, Hash, *P,
+                                    readProfile(*countersAddr, *P))}) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,186 @@
+/* Compare the code layout and execution time of functions with large,
+never executed error paths, compiled with and without machine function
+splitting. The profile is collected in-process by an instrumented run. */
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/TargetSelect.h"
+#include "loader.h"
+#include "perfcount.h"
+#include "profile.h"
+
+#include <chrono>
+#include <cinttypes> /* PRIu64 */
+#include <cstdio> /* printf() */
+#include <cstdlib> /* atoi(), getenv() */
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+/** Create functions int fI(int x)
+{ if (x < 0) return <cold operations on x>; return x * 3 + I; }
+and int run(int x) { return f0(x) + f1(x) + ...; } */
+static std::unique_ptr<llvm::Module> createModule(llvm::LLVMContext &C,
+                                                  unsigned n, unsigned cold)
+{
+  auto M = std::make_unique<llvm::Module>("heLLoSplit", C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionType *FT = llvm::FunctionType::get(intType, {intType}, false);
+
+  for (unsigned i = 0; i < n; i++) {
+    llvm::Function *TheFunction =
+      llvm::Function::Create(FT, llvm::Function::ExternalLinkage,
+                             "f" + std::to_string(i), M.get());
+    TheFunction->setDoesNotThrow();
+    /* Keep the calls from run(), so that the layout matters. */
+    TheFunction->addFnAttr(llvm::Attribute::NoInline);
+    auto Entry = llvm::BasicBlock::Create(C, "entry", TheFunction);
+    auto Error = llvm::BasicBlock::Create(C, "error", TheFunction);
+    auto Ok = llvm::BasicBlock::Create(C, "ok", TheFunction);
+    llvm::Value *x = TheFunction->arg_begin();
+
+    llvm::IRBuilder<> builder(Entry);
+    builder.CreateCondBr(builder.CreateICmpSLT(x, builder.getInt32(0)),
+                         Error, Ok);
+    builder.SetInsertPoint(Error);
+    for (unsigned b = 0; b < cold; b++)
+      x = b & 1
+        ? builder.CreateXor(x, builder.CreateLShr(x, 1 + (i + b) % 15))
+        : builder.CreateMul(x, builder.getInt32(2 * (i + b) + 3));
+    builder.CreateRet(x);
+    builder.SetInsertPoint(Ok);
+    x = TheFunction->arg_begin();
+    builder.CreateRet(builder.CreateAdd(builder.CreateMul
+                                        (x, builder.getInt32(3)),
+                                        builder.getInt32(i)));
+  }
+
+  llvm::Function *Run =
+    llvm::Function::Create(FT, llvm::Function::ExternalLinkage, "run",
+                           M.get());
+  Run->setDoesNotThrow();
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(C, "entry", Run));
+  llvm::Value *x = Run->arg_begin(), *sum = builder.getInt32(0);
+  for (unsigned i = 0; i < n; i++)
+    sum = builder.CreateAdd(sum, builder.CreateCall
+                            (M->getFunction("f" + std::to_string(i)), x));
+  builder.CreateRet(sum);
+  return M;
+}
+
+/** Load a module and look up all its functions. */
+static llvm::Error load(Loader &L, std::unique_ptr<llvm::Module> M,
+                        std::vector<int(*)(int)> &Fns)
+{
+  std::vector<std::string> Strings;
+  for (const llvm::Function &F : *M)
+    if (!F.isDeclaration())
+      Strings.push_back(F.getName().str());
+  std::vector<llvm::StringRef> Names(Strings.begin(), Strings.end());
+  std::vector<uint64_t> Addrs(Names.size());
+
+  llvm::Expected<LoadedModule*> LM{L.add(std::move(M))};
+  if (!LM)
+    return LM.takeError();
+  if (llvm::Error Err{L.lookup(Names, Addrs)})
+    return Err;
+
+  Fns.clear();
+  for (uint64_t Addr : Addrs)
+    Fns.push_back(reinterpret_cast<int(*)(int)>(Addr));
+  return llvm::Error::success();
+}
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  {
+    /* By default, a block is cold if its count is below a percentile of
+    the profile summary, which would include all blocks when the counts
+    are uniform. Only split blocks that were never executed. This option
+    affects every TargetMachine in the process. */
+    const char *Args[] = {argv[0], "-mfs-psi-cutoff=0"};
+    llvm::cl::ParseCommandLineOptions(2, Args);
+  }
+
+  if (getenv("HELLOVM_PERF"))
+    PerfEnable();
+
+  unsigned n = argc > 1 ? atoi(argv[1]) : 1000;
+  unsigned cold = argc > 2 ? atoi(argv[2]) : 100;
+  int rounds = argc > 3 ? atoi(argv[3]) : 1000;
+
+  std::vector<int(*)(int)> Fns;
+  std::vector<uint64_t> Counters;
+
+  {
+    /* Training run of an instrumented module */
+    auto L = Loader::Create();
+    if (!L) {
+      llvm::errs() << L.takeError() << '\n';
+      return 1;
+    }
+    llvm::LLVMContext C;
+    auto M = createModule(C, n, cold);
+    const ProfileCounters P{instrumentProfile(*M, getModuleHash(*M))};
+    llvm::Error Err{load(**L, std::move(M), Fns)};
+    llvm::Expected<uint64_t> Addr{Err
+                                  ? llvm::Expected<uint64_t>(std::move(Err))
+                                  : (*L)->lookup(P.Name)};
+    if (!Addr) {
+      llvm::errs() << Addr.takeError() << '\n';
+      return 1;
+    }
+    /* Machine function splitting requires a count of 0 for cold blocks
+    and at least 1 for the others. */
+    for (int r = 0; r < 100; r++)
+      Fns.back()(r);
+    Counters = readProfile(*Addr, P);
+  }
+
+  printf("split\thot_bytes\tcold_bytes\tns_per_call\tchecksum\n");
+
+  for (bool split : {false, true}) {
+    auto L = Loader::Create();
+    if (!L) {
+      llvm::errs() << L.takeError() << '\n';
+      return 1;
+    }
+    (*L)->setSplitMachineFunctions(split);
+
+    llvm::LLVMContext C;
+    auto M = createModule(C, n, cold);
+    llvm::Error Err{applyProfile(*M, Counters)};
+    if (!Err)
+      Err = load(**L, std::move(M), Fns);
+    if (Err) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+
+    PerfEntry *E = PerfRegister(split ? "run_split" : "run",
+                                reinterpret_cast<uint64_t>(Fns.back()));
+    unsigned checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+      PerfScope S{E};
+      for (int r = 0; r < rounds; r++)
+        checksum += Fns.back()(r);
+    }
+    std::chrono::duration<double, std::nano> ns
+      {std::chrono::steady_clock::now() - start};
+
+    printf("%d\t%" PRIu64 "\t%" PRIu64 "\t%.2f\t%08x\n", split,
+           (*L)->getCodeSize(false), (*L)->getCodeSize(true),
+           ns.count() / (double(rounds) * n), checksum);
+  }
+
+  if (PerfEnabled())
+    PerfDump(stderr);
+  return 0;
+}
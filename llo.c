@@ -11,6 +11,7 @@
 #include "mcjit.h"
 
 #include <stdio.h> /* puts(), fopen() */
+#include <stdlib.h> /* getenv() */
 
 #define FALSE 0
 #define TRUE 1
@@ -19,6 +20,8 @@ int main(int argc, char **argv)
 {
   LLVMInitializeNativeTarget();
   LLVMInitializeNativeAsmPrinter();
+  if (getenv("HELLOVM_PERF"))
+    PerfEnable();
 
   LLVMContextRef C = LLVMContextCreate();
   LLVMModuleRef M = LLVMModuleCreateWithNameInContext("heLLoVM-C", C);
@@ -91,7 +94,8 @@ int main(int argc, char **argv)
     return 1;
   }
 
-  uint64_t f = LLVMGetFunctionAddress(EE, "boo");
+  PerfEntry *booPerf;
+  uint64_t f = GetCountedFunctionAddress(EE, "boo", &booPerf);
   uint64_t gv = LLVMGetGlobalValueAddress(EE, "greetings");
 
   printf("boo=%" PRIx64 ", greetings=%" PRIx64 "\n", f, gv);
@@ -107,7 +111,12 @@ int main(int argc, char **argv)
   typedef int (*callback)(const char*);
   int (*boo) (const char *, callback, unsigned) =
     ((int (*)(const char *, callback, unsigned)) f);
+  PerfReading start;
+  PerfStart(&start);
   int ret = boo("hello", puts, 0) + boo("goodbye", puts, 1);
+  PerfStop(booPerf, &start);
+  if (PerfEnabled())
+    PerfDump(stderr);
   LLVMDisposeExecutionEngine(EE);
   LLVMContextDispose(C);
   return ret;
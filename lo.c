@@ -9,12 +9,9 @@
 # include <string.h> /* memcmp() */
 #endif
 
-#include <string.h> /* memcpy() */
 #include <stdio.h> /* puts(), fopen() */
-#include <stdlib.h> /* posix_memalign() */
 
-#include <unistd.h> /* sysconf(_SC_PAGESIZE) */
-#include <sys/mman.h> /* mmap(), mprotect() */
+#include "codemem.h"
 
 #define FALSE 0
 #define TRUE 1
@@ -132,22 +129,18 @@ int main(int argc, char **argv)
 
   printf("size: %zu\n", textsize);
 
-  long sz = sysconf(_SC_PAGESIZE);
-  size_t size = (textsize + (sz - 1)) & ~(sz - 1);
-  void *buf =
-    mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-  if (buf == MAP_FAILED) {
+  CodeMem CM;
+  if (CodeMemCreate(&CM, textsize)) {
     LLVMDisposeMemoryBuffer(ObjBuffer);
     return 2;
   }
 
-  memcpy(buf, text, textsize);
+  void *buf = CodeMemInstall(&CM, text, textsize);
   LLVMDisposeMemoryBuffer(ObjBuffer);
-  mprotect(buf, size, PROT_READ | PROT_EXEC);
   typedef int (*callback)(const char*);
   int (*boo) (const char *, callback, const char *) =
     ((int (*)(const char *, callback, const char *)) buf);
   int ret = boo("hello", puts, "world") + boo("goodbye", puts, "all");
-  munmap(buf, size);
+  CodeMemDispose(&CM);
   return ret;
 }
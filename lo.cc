@@ -18,9 +18,8 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 
-#include <cstring> /* memcpy() */
-#include <unistd.h> /* sysconf(_SC_PAGESIZE) */
-#include <sys/mman.h> /* mmap(), mprotect() */
+#include <cstring> /* memcmp() */
+#include "codemem.h"
 
 #if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
 namespace std { using llvm::make_unique; }
@@ -150,18 +149,14 @@ int main(int argc, char **argv)
 
   printf("size: %zu\n", textsize);
 
-  long sz = sysconf(_SC_PAGESIZE);
-  size_t size = (textsize + (sz - 1)) & ~(sz - 1);
-  void *buf = mmap(nullptr, size, PROT_READ|PROT_WRITE,
-                   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-  if (buf == MAP_FAILED)
+  CodeMem CM;
+  if (CodeMemCreate(&CM, textsize))
     return 2;
-  memcpy(buf, text, textsize);
-  mprotect(buf, size, PROT_READ | PROT_EXEC);
+  void *buf = CodeMemInstall(&CM, text, textsize);
   typedef int (*callback)(const char*);
   auto boo =
     reinterpret_cast<int(*)(const char *, callback, const char *)>(buf);
   int ret = boo("hello", puts, "world") + boo("goodbye", puts, "all");
-  munmap(buf, size);
+  CodeMemDispose(&CM);
   return ret;
 }
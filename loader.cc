@@ -0,0 +1,423 @@
+#include "loader.h"
+
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/SmallVectorMemoryBuffer.h"
+#if LLVM_VERSION_MAJOR < 14
+# include "llvm/Support/TargetRegistry.h"
+#else
+# include "llvm/MC/TargetRegistry.h"
+#endif
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+const char *getLoadPathName(LoadPath P)
+{
+  switch (P) {
+  case LoadPath::Blob:
+    return "blob";
+  case LoadPath::ORC:
+    return "orc";
+  }
+  return "?";
+}
+
+bool HotColdMemoryManager::isCold(llvm::StringRef SectionName)
+{
+  /* machine function splitting, or functions with a cold profile */
+  return SectionName.startswith(".text.split.") ||
+    SectionName.startswith(".text.unlikely.");
+}
+
+uint8_t *HotColdMemoryManager::allocateCodeSection(uintptr_t Size,
+                                                   unsigned Alignment,
+                                                   unsigned,
+                                                   llvm::StringRef
+                                                   SectionName)
+{
+  const bool IsCold = isCold(SectionName);
+  CodeSize[IsCold] += Size;
+  return allocate(Size, Alignment, IsCold ? Place::ColdCode : Place::Code, true);
+}
+
+Loader::Loader(std::unique_ptr<llvm::orc::ExecutionSession> ES,
+               std::unique_ptr<llvm::TargetMachine> TM, char GP) :
+  ES(std::move(ES)), TM(std::move(TM)), DL(this->TM->createDataLayout()),
+  Mangle(*this->ES, DL),
+  ObjectLayer(*this->ES,
+              [this]() {
+                return std::make_unique<HotColdMemoryManager>(CodeSize);
+              }),
+  JD(&this->ES->createBareJITDylib("<main>"))
+{
+  JD->addGenerator
+    (cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess
+              (GP)));
+}
+
+Loader::~Loader()
+{
+  if (llvm::Error Err{ES->endSession()})
+    llvm::logAllUnhandledErrors(std::move(Err), llvm::errs(), "");
+  for (CodeChunk &C : Code)
+    CodeMemDispose(&C.CM);
+}
+
+void Loader::setSplitMachineFunctions(bool Split)
+{
+  TM->Options.EnableMachineFunctionSplitter = Split;
+}
+
+llvm::Expected<std::unique_ptr<Loader>> Loader::Create()
+{
+  auto EPC = llvm::orc::SelfExecutorProcessControl::Create();
+  if (!EPC)
+    return EPC.takeError();
+
+  auto ES = std::make_unique<llvm::orc::ExecutionSession>(std::move(*EPC));
+  llvm::orc::JITTargetMachineBuilder JTMB
+    {ES->getExecutorProcessControl().getTargetTriple()};
+  JTMB.setRelocationModel(llvm::Reloc::PIC_);
+  llvm::Expected<std::unique_ptr<llvm::TargetMachine>> TM
+    {JTMB.createTargetMachine()};
+  if (!TM) {
+    cantFail(ES->endSession());
+    return TM.takeError();
+  }
+
+  const char GP = (*TM)->createDataLayout().getGlobalPrefix();
+  return std::unique_ptr<Loader>(new Loader(std::move(ES), std::move(*TM),
+                                            GP));
+}
+
+void Loader::optimize(llvm::Module &M)
+{
+  M.setDataLayout(DL);
+  M.setTargetTriple(TM->getTargetTriple().str());
+
+  if (OptimizeIR) {
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+    llvm::PassBuilder PB{TM.get()};
+
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    using OptimizationLevel = llvm::
+#if LLVM_VERSION_MAJOR < 14
+      PassBuilder::
+#endif
+      OptimizationLevel;
+
+    PB.buildPerModuleDefaultPipeline(OptimizationLevel::O2).run(M, MAM);
+  }
+}
+
+llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>>
+Loader::emit(llvm::Module &M)
+{
+  llvm::SmallVector<char, 0> ObjBufferSV;
+  {
+    llvm::raw_svector_ostream ObjStream(ObjBufferSV);
+    llvm::legacy::PassManager PM;
+    llvm::MCContext *Ctx;
+    if (TM->addPassesToEmitMC(PM, Ctx, ObjStream))
+      return llvm::make_error<llvm::StringError>
+        ("cannot emit object code", llvm::inconvertibleErrorCode());
+    PM.run(M);
+  }
+
+  return std::make_unique<llvm::SmallVectorMemoryBuffer>
+    (std::move(ObjBufferSV), M.getModuleIdentifier());
+}
+
+llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>>
+Loader::compile(llvm::Module &M)
+{
+  optimize(M);
+  return emit(M);
+}
+
+llvm::Expected<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+Loader::compile(llvm::Module &M, unsigned Threads)
+{
+  optimize(M);
+
+  std::vector<llvm::SmallVector<char, 0>> Buffers(std::max(Threads, 1U));
+  std::vector<std::unique_ptr<llvm::raw_svector_ostream>> Streams;
+  std::vector<llvm::raw_pwrite_stream*> OSs;
+  for (auto &B : Buffers) {
+    Streams.emplace_back(new llvm::raw_svector_ostream(B));
+    OSs.push_back(Streams.back().get());
+  }
+
+  /* Each part is written to bitcode and parsed into a new LLVMContext,
+  which will be compiled by a TargetMachine that is like ours. */
+  llvm::splitCodeGen(M, OSs, {}, [this]() {
+    return std::unique_ptr<llvm::TargetMachine>
+      (TM->getTarget().createTargetMachine
+       (TM->getTargetTriple().str(), TM->getTargetCPU(),
+        TM->getTargetFeatureString(), TM->Options, TM->getRelocationModel(),
+        TM->getCodeModel(), TM->getOptLevel()));
+  });
+  Streams.clear();
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> Objs;
+  for (size_t i = 0; i < Buffers.size(); i++)
+    Objs.emplace_back(new llvm::SmallVectorMemoryBuffer
+                      (std::move(Buffers[i]),
+                       M.getModuleIdentifier() + "." + std::to_string(i)));
+  return Objs;
+}
+
+llvm::Optional<llvm::object::SectionRef>
+Loader::isSelfContained(const llvm::object::ObjectFile &Obj)
+{
+  const auto *ELF = llvm::dyn_cast<llvm::object::ELFObjectFileBase>(&Obj);
+  if (!ELF)
+    return llvm::None;
+
+  llvm::Optional<llvm::object::SectionRef> Text;
+
+  for (const llvm::object::ELFSectionRef Sec : ELF->sections()) {
+    llvm::Expected<llvm::StringRef> Name{Sec.getName()};
+    if (!Name) {
+      llvm::consumeError(Name.takeError());
+      return llvm::None;
+    }
+    if (*Name == ".eh_frame" || *Name == ".rela.eh_frame")
+      /* Unwind information is not registered for blobs. */
+      continue;
+    if (!Sec.relocations().empty())
+      return llvm::None;
+    if (!(Sec.getFlags() & llvm::ELF::SHF_ALLOC) || !Sec.getSize())
+      continue;
+    /* Anything else than a single .text (such as .rodata, .data, or
+    a second .text, see https://github.com/llvm/llvm-project/issues/57274)
+    would have to be linked. */
+    if (Text || !Sec.isText() || Sec.isVirtual())
+      return llvm::None;
+    Text = Sec;
+  }
+
+  if (!Text)
+    return llvm::None;
+
+  for (const llvm::object::SymbolRef &Sym : Obj.symbols()) {
+    llvm::Expected<uint32_t> Flags{Sym.getFlags()};
+    if (!Flags) {
+      llvm::consumeError(Flags.takeError());
+      return llvm::None;
+    }
+    if (*Flags & llvm::object::SymbolRef::SF_Undefined)
+      return llvm::None;
+  }
+
+  return Text;
+}
+
+llvm::Error Loader::addBlob(LoadedModule &LM,
+                            const llvm::object::ObjectFile &Obj,
+                            const llvm::object::SectionRef &Text)
+{
+  llvm::Expected<llvm::StringRef> Contents{Text.getContents()};
+  if (!Contents)
+    return Contents.takeError();
+
+  std::vector<std::pair<llvm::orc::SymbolStringPtr, uint64_t>> Symbols;
+  for (const llvm::object::SymbolRef &Sym : Obj.symbols()) {
+    llvm::Expected<uint32_t> Flags{Sym.getFlags()};
+    if (!Flags)
+      return Flags.takeError();
+    if (!(*Flags & llvm::object::SymbolRef::SF_Global))
+      continue;
+    llvm::Expected<llvm::object::section_iterator> Sec{Sym.getSection()};
+    if (!Sec)
+      return Sec.takeError();
+    if (*Sec == Obj.section_end() || !(**Sec == Text))
+      continue;
+    llvm::Expected<llvm::StringRef> Name{Sym.getName()};
+    if (!Name)
+      return Name.takeError();
+    llvm::Expected<uint64_t> Offset{Sym.getValue()};
+    if (!Offset)
+      return Offset.takeError();
+    Symbols.emplace_back(ES->intern(*Name), *Offset);
+  }
+
+  void *Addr = Code.empty()
+    ? nullptr
+    : CodeMemInstall(&Code.back().CM, Contents->data(), Contents->size());
+  if (!Addr) {
+    CodeChunk C{CodeMem(), 0};
+    if (int err = CodeMemCreate(&C.CM, std::max<size_t>(Contents->size(),
+                                                        1 << 16)))
+      return llvm::errorCodeToError(std::error_code(err,
+                                                    std::generic_category()));
+    Code.push_back(C);
+    Addr = CodeMemInstall(&Code.back().CM, Contents->data(),
+                          Contents->size());
+  }
+
+  LM.Chunk = &Code.back();
+  LM.Chunk->Modules++;
+
+  /* The symbols are visible to modules of either path, and any duplicate
+  definition will be rejected. */
+  llvm::orc::SymbolMap Defs;
+  for (const auto &S : Symbols)
+    Defs[S.first] =
+      llvm::JITEvaluatedSymbol(reinterpret_cast<uint64_t>(Addr) + S.second,
+                               llvm::JITSymbolFlags::Exported |
+                               llvm::JITSymbolFlags::Callable);
+  if (llvm::Error Err{JD->define(llvm::orc::absoluteSymbols(std::move(Defs)),
+                                 LM.RT)}) {
+    release(LM.Chunk);
+    return Err;
+  }
+  return llvm::Error::success();
+}
+
+void Loader::release(CodeChunk *Chunk)
+{
+  if (--Chunk->Modules)
+    return;
+  if (Chunk == &Code.back())
+    /* Reuse the code memory for subsequent modules. */
+    Chunk->CM.used = 0;
+  else
+    for (auto I = Code.begin(); I != Code.end(); ++I)
+      if (&*I == Chunk) {
+        CodeMemDispose(&I->CM);
+        Code.erase(I);
+        break;
+      }
+}
+
+llvm::Expected<LoadedModule*> Loader::add(std::unique_ptr<llvm::Module> M)
+{
+  auto Obj = compile(*M);
+  if (!Obj)
+    return Obj.takeError();
+  return add(std::move(*Obj));
+}
+
+llvm::Expected<LoadedModule*> Loader::add(std::unique_ptr<llvm::Module> M,
+                                          unsigned Threads)
+{
+  if (Threads <= 1)
+    return add(std::move(M));
+  auto Objs = compile(*M, Threads);
+  if (!Objs)
+    return Objs.takeError();
+  return add(std::move(*Objs));
+}
+
+llvm::Expected<LoadedModule*>
+Loader::add(std::vector<std::unique_ptr<llvm::MemoryBuffer>> Objs)
+{
+  if (Objs.size() == 1)
+    return add(std::move(Objs.front()));
+
+  std::unique_ptr<LoadedModule> LM
+    {new LoadedModule{LoadPath::ORC, JD->createResourceTracker(), nullptr}};
+  for (auto &Obj : Objs)
+    if (llvm::Error Err{ObjectLayer.add(LM->RT, std::move(Obj))}) {
+      llvm::consumeError(LM->RT->remove());
+      return Err;
+    }
+
+  Loaded[unsigned(LM->Path)]++;
+  LoadedModule *Result = LM.get();
+  Modules[Result] = std::move(LM);
+  return Result;
+}
+
+llvm::Expected<LoadedModule*>
+Loader::add(std::unique_ptr<llvm::MemoryBuffer> Obj)
+{
+  auto O = llvm::object::ObjectFile::createObjectFile(Obj->getMemBufferRef());
+  if (!O)
+    return O.takeError();
+
+  std::unique_ptr<LoadedModule> LM
+    {new LoadedModule{LoadPath::Blob, JD->createResourceTracker(), nullptr}};
+
+  if (llvm::Optional<llvm::object::SectionRef> Text = isSelfContained(**O)) {
+    if (llvm::Error Err{addBlob(*LM, **O, *Text)}) {
+      llvm::consumeError(LM->RT->remove());
+      return Err;
+    }
+  } else {
+    LM->Path = LoadPath::ORC;
+    if (llvm::Error Err{ObjectLayer.add(LM->RT, std::move(Obj))}) {
+      llvm::consumeError(LM->RT->remove());
+      return Err;
+    }
+  }
+
+  Loaded[unsigned(LM->Path)]++;
+  LoadedModule *Result = LM.get();
+  Modules[Result] = std::move(LM);
+  return Result;
+}
+
+llvm::Error Loader::remove(LoadedModule *LM)
+{
+  llvm::Error Err{LM->RT->remove()};
+  if (LM->Chunk)
+    release(LM->Chunk);
+  Modules.erase(LM);
+  return Err;
+}
+
+llvm::Expected<uint64_t> Loader::lookup(llvm::StringRef Name)
+{
+  llvm::Expected<llvm::JITEvaluatedSymbol> Sym
+    {ES->lookup(llvm::orc::makeJITDylibSearchOrder
+                (JD, llvm::orc::JITDylibLookupFlags::MatchAllSymbols),
+                Mangle(Name))};
+  if (!Sym)
+    return Sym.takeError();
+  return Sym->getAddress();
+}
+
+llvm::Error Loader::lookup(llvm::ArrayRef<llvm::StringRef> Names,
+                           llvm::MutableArrayRef<uint64_t> Addrs)
+{
+  assert(Names.size() == Addrs.size());
+  std::vector<llvm::orc::SymbolStringPtr> Mangled;
+  llvm::orc::SymbolLookupSet Symbols;
+  Mangled.reserve(Names.size());
+
+  for (size_t i = 0; i < Names.size(); i++) {
+    Mangled.push_back(Mangle(Names[i]));
+    Symbols.add(Mangled.back(),
+                llvm::orc::SymbolLookupFlags::WeaklyReferencedSymbol);
+  }
+  Symbols.removeDuplicates();
+
+  auto Syms = ES->lookup(llvm::orc::makeJITDylibSearchOrder
+                         (JD, llvm::orc::JITDylibLookupFlags::MatchAllSymbols),
+                         std::move(Symbols));
+  if (!Syms)
+    return Syms.takeError();
+
+  for (size_t i = 0; i < Names.size(); i++) {
+    auto S = Syms->find(Mangled[i]);
+    Addrs[i] = S == Syms->end() ? 0 : S->second.getAddress();
+  }
+  return llvm::Error::success();
+}
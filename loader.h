@@ -0,0 +1,182 @@
+#ifndef LOADER_H
+#define LOADER_H
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <list>
+
+#include "codemem.h"
+#include "codememmgr.h"
+
+/** How a module was loaded by Loader::add() */
+enum class LoadPath
+{
+  /** .text was copied to a CodeMem without any linking (see lo.cc) */
+  Blob,
+  /** the object was linked by ORCv2 RTDyldObjectLinkingLayer */
+  ORC
+};
+
+const char *getLoadPathName(LoadPath P);
+
+/** Code memory for LoadPath::Blob */
+struct CodeChunk
+{
+  CodeMem CM;
+  /** number of loaded modules whose code is in CM */
+  size_t Modules;
+};
+
+/** A module that was loaded by Loader::add() */
+struct LoadedModule
+{
+  LoadPath Path;
+  /** the tracker of the symbols, and of the code of LoadPath::ORC */
+  llvm::orc::ResourceTrackerSP RT;
+  /** the code memory (LoadPath::Blob) */
+  CodeChunk *Chunk;
+};
+
+/** A memory manager for the ORC path that allocates the code of cold
+sections (see Loader::setSplitMachineFunctions()) downwards from the end
+of the code memory of an object, apart from other code, so that the hot
+code of an object will be packed together. ORC creates one memory manager
+per object; the hot code of different objects is not packed together. */
+class HotColdMemoryManager : public CodeMemManager
+{
+public:
+  /** @param CodeSize  output: total size of hot and cold code sections */
+  explicit HotColdMemoryManager(uint64_t (&CodeSize)[2]) :
+    CodeSize(CodeSize) {}
+
+  /** @return whether a code section contains cold code */
+  static bool isCold(llvm::StringRef SectionName);
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               llvm::StringRef SectionName) override;
+
+private:
+  uint64_t (&CodeSize)[2];
+};
+
+/** Compile modules to position-independent objects and load each of
+them by the cheapest possible means: a self-contained .text section is
+copied as is, while anything that requires relocations or external
+symbols is passed to the ORCv2 object linking layer. Not thread-safe. */
+class Loader
+{
+public:
+  static llvm::Expected<std::unique_ptr<Loader>> Create();
+  ~Loader();
+
+  /** Enable or disable the splitting of blocks that a profile reports
+  as cold (see applyProfile()) into separate cold sections. Which blocks
+  are cold is determined by the process-wide LLVM option -mfs-psi-cutoff,
+  which the application may set (see llo-split.cc). */
+  void setSplitMachineFunctions(bool Split);
+
+  /** Enable or disable the O2 pipeline in optimize(). Code generation
+  will optimize in any case. */
+  void setOptimizeIR(bool Optimize) { OptimizeIR = Optimize; }
+
+  /** Run the O2 pipeline on a module, unless disabled by setOptimizeIR(). */
+  void optimize(llvm::Module &M);
+
+  /** Optimize a module and compile it to an object file. */
+  llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>>
+  compile(llvm::Module &M);
+
+  /** Optimize a module, split it into parts, and compile them to object
+  files concurrently, each part in its own LLVMContext and TargetMachine.
+  @param Threads  the number of parts and threads */
+  llvm::Expected<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+  compile(llvm::Module &M, unsigned Threads);
+
+  /** Determine whether an object can be loaded without a linker.
+  @return the .text section of a self-contained object
+  @retval None if relocations or external symbols must be resolved */
+  static llvm::Optional<llvm::object::SectionRef>
+  isSelfContained(const llvm::object::ObjectFile &Obj);
+
+  /** Compile and load a module.
+  @return the loaded module, which is owned by the Loader */
+  llvm::Expected<LoadedModule*> add(std::unique_ptr<llvm::Module> M);
+
+  /** Compile a module by compile(M, Threads) and load the parts.
+  @return the loaded module, which is owned by the Loader */
+  llvm::Expected<LoadedModule*> add(std::unique_ptr<llvm::Module> M,
+                                    unsigned Threads);
+
+  /** Load a compiled object.
+  @return the loaded module, which is owned by the Loader */
+  llvm::Expected<LoadedModule*> add(std::unique_ptr<llvm::MemoryBuffer> Obj);
+
+  /** Load the parts of a split module side by side by the ORC path,
+  so that they can refer to each other.
+  @return the loaded module, which is owned by the Loader */
+  llvm::Expected<LoadedModule*>
+  add(std::vector<std::unique_ptr<llvm::MemoryBuffer>> Objs);
+
+  /** Unload a module, freeing its code and symbols. Other modules that
+  were loaded into the same JITDylib are not affected.
+  @param LM  the result of add() */
+  llvm::Error remove(LoadedModule *LM);
+
+  /** Look up a symbol that was defined by a loaded module. */
+  llvm::Expected<uint64_t> lookup(llvm::StringRef Name);
+
+  /** Look up several symbols by a single lookup in the ExecutionSession.
+  @param Addrs  output: the addresses, or 0 for symbols that were not found */
+  llvm::Error lookup(llvm::ArrayRef<llvm::StringRef> Names,
+                     llvm::MutableArrayRef<uint64_t> Addrs);
+
+  /** @return the total size of code sections that were allocated by
+  the ORC path, either cold (see setSplitMachineFunctions()) or hot */
+  uint64_t getCodeSize(bool Cold) const { return CodeSize[Cold]; }
+
+  /** @return the number of modules that were loaded by a path */
+  unsigned getLoaded(LoadPath P) const { return Loaded[unsigned(P)]; }
+
+  llvm::orc::ExecutionSession &getExecutionSession() { return *ES; }
+  llvm::orc::JITDylib &getMainJITDylib() { return *JD; }
+  const llvm::DataLayout &getDataLayout() const { return DL; }
+
+private:
+  Loader(std::unique_ptr<llvm::orc::ExecutionSession> ES,
+         std::unique_ptr<llvm::TargetMachine> TM, char GP);
+
+  /** Generate code for an optimized module. */
+  llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> emit(llvm::Module &M);
+
+  /** Copy a self-contained .text section to a CodeMem, and define its
+  global symbols in the main JITDylib as absolute symbols. */
+  llvm::Error addBlob(LoadedModule &LM, const llvm::object::ObjectFile &Obj,
+                      const llvm::object::SectionRef &Text);
+
+  /** Release a reference to a CodeChunk. */
+  void release(CodeChunk *Chunk);
+
+  std::unique_ptr<llvm::orc::ExecutionSession> ES;
+  std::unique_ptr<llvm::TargetMachine> TM;
+  const llvm::DataLayout DL;
+  llvm::orc::MangleAndInterner Mangle;
+  llvm::orc::RTDyldObjectLinkingLayer ObjectLayer;
+  llvm::orc::JITDylib *JD;
+  /** code memory for the Blob path; the last one is being filled */
+  std::list<CodeChunk> Code;
+  /** the loaded modules */
+  llvm::DenseMap<const LoadedModule*, std::unique_ptr<LoadedModule>> Modules;
+  unsigned Loaded[2] = {0, 0};
+  /** see setOptimizeIR() */
+  bool OptimizeIR = true;
+  /** see getCodeSize() */
+  uint64_t CodeSize[2] = {0, 0};
+};
+#endif
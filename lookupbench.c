@@ -0,0 +1,149 @@
+/* Compare N single-symbol lookups with one batched lookup of N symbols
+in a module that exports N functions. The first ("cold") pass includes
+the materialization of the module; the second ("warm") pass does not. */
+#include "llvm-c/Core.h"
+#include "llvm-c/LLJIT.h"
+#include "llvm-c/OrcEE.h"
+#include "llvm-c/Target.h"
+#include "orc.h"
+
+#include <stdio.h> /* printf(), snprintf() */
+#include <stdlib.h> /* atoi(), malloc() */
+#include <time.h> /* clock_gettime() */
+
+#define FALSE 0
+#define TRUE 1
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+/** Create a module with int fI(int x) { return x + I; } for I < n. */
+static LLVMOrcThreadSafeModuleRef create_module(int n, char *const *names)
+{
+  LLVMOrcThreadSafeContextRef TSC = LLVMOrcCreateNewThreadSafeContext();
+  LLVMContextRef C = LLVMOrcThreadSafeContextGetContext(TSC);
+  LLVMModuleRef M = LLVMModuleCreateWithNameInContext("lookupbench", C);
+  LLVMTypeRef intType = LLVMInt32TypeInContext(C);
+  LLVMTypeRef FT = LLVMFunctionType(intType, &intType, 1, FALSE);
+  LLVMBuilderRef builder = LLVMCreateBuilderInContext(C);
+
+  for (int i = 0; i < n; i++) {
+    LLVMValueRef TheFunction = LLVMAddFunction(M, names[i], FT);
+    LLVMSetLinkage(TheFunction, LLVMExternalLinkage);
+    LLVMPositionBuilderAtEnd(builder,
+                             LLVMAppendBasicBlockInContext(C, TheFunction,
+                                                           "entry"));
+    LLVMBuildRet(builder,
+                 LLVMBuildAdd(builder, LLVMGetParam(TheFunction, 0),
+                              LLVMConstInt(intType, i, FALSE), ""));
+  }
+
+  LLVMDisposeBuilder(builder);
+  LLVMOrcThreadSafeModuleRef TSM = LLVMOrcCreateNewThreadSafeModule(M, TSC);
+  LLVMOrcDisposeThreadSafeContext(TSC);
+  return TSM;
+}
+
+/** Look up all symbols, either one at a time or in a batch.
+@return the elapsed time in microseconds, or a negative value on error */
+static double lookup_all(LLVMOrcLLJITRef Jit, LLVMOrcJITDylibRef JD,
+                         LLVMOrcJITTargetAddress *addrs,
+                         char *const *names, int n, int batch)
+{
+  LLVMErrorRef Err = LLVMErrorSuccess;
+  double start = now();
+  if (batch)
+    Err = LLVM_LookupBatch(Jit, JD, addrs, (const char *const *) names, n);
+  else
+    for (int i = 0; i < n && !Err; i++)
+      Err = LLVM_Lookup(Jit, JD, &addrs[i], names[i]);
+  double elapsed = now() - start;
+
+  if (Err) {
+    char *ErrMsg = LLVMGetErrorMessage(Err);
+    fprintf(stderr, "Error: %s\n", ErrMsg);
+    LLVMDisposeErrorMessage(ErrMsg);
+    return -1;
+  }
+  for (int i = 0; i < n; i++)
+    if (!addrs[i] || ((int (*)(int)) addrs[i])(1) != i + 1) {
+      fprintf(stderr, "Error: wrong address for %s\n", names[i]);
+      return -1;
+    }
+  return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+  LLVMInitializeNativeTarget();
+  LLVMInitializeNativeAsmPrinter();
+
+  int n = argc > 1 ? atoi(argv[1]) : 500;
+  int rounds = argc > 2 ? atoi(argv[2]) : 10;
+  if (n < 1)
+    n = 1;
+
+  char **names = malloc(n * sizeof *names);
+  LLVMOrcJITTargetAddress *addrs = malloc(n * sizeof *addrs);
+  for (int i = 0; i < n; i++) {
+    names[i] = malloc(16);
+    snprintf(names[i], 16, "f%d", i);
+  }
+
+  LLVMOrcLLJITRef Jit;
+  LLVMErrorRef Err = LLVMOrcCreateLLJIT(&Jit, LLVMOrcCreateLLJITBuilder());
+  if (Err) {
+    char *ErrMsg = LLVMGetErrorMessage(Err);
+    fprintf(stderr, "Error: %s\n", ErrMsg);
+    LLVMDisposeErrorMessage(ErrMsg);
+    return 1;
+  }
+  LLVMOrcJITDylibRef JD = LLVMOrcLLJITGetMainJITDylib(Jit);
+
+  /* cold and warm, for single and batched lookups */
+  double total[2][2] = {{0, 0}, {0, 0}};
+  int ret = 0;
+
+  for (int r = 0; r < rounds && !ret; r++)
+    for (int batch = 0; batch < 2 && !ret; batch++) {
+      LLVMOrcResourceTrackerRef RT;
+      if ((Err = LLVM_AddModule(Jit, JD, create_module(n, names), &RT))) {
+        char *ErrMsg = LLVMGetErrorMessage(Err);
+        fprintf(stderr, "Error: %s\n", ErrMsg);
+        LLVMDisposeErrorMessage(ErrMsg);
+        ret = 1;
+        break;
+      }
+      for (int warm = 0; warm < 2; warm++) {
+        double t = lookup_all(Jit, JD, addrs, names, n, batch);
+        if (t < 0) {
+          ret = 1;
+          break;
+        }
+        total[batch][warm] += t;
+      }
+      if ((Err = LLVM_RemoveModule(RT))) {
+        LLVMConsumeError(Err);
+        ret = 1;
+      }
+    }
+
+  if (!ret) {
+    printf("symbols\tsingle_cold_us\tbatch_cold_us\t"
+           "single_warm_us\tbatch_warm_us\n");
+    printf("%d\t%.0f\t%.0f\t%.0f\t%.0f\n", n,
+           total[0][0] / rounds, total[1][0] / rounds,
+           total[0][1] / rounds, total[1][1] / rounds);
+  }
+
+  for (int i = 0; i < n; i++)
+    free(names[i]);
+  free(names);
+  free(addrs);
+  LLVMOrcDisposeLLJIT(Jit);
+  return ret;
+}
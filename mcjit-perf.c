@@ -0,0 +1,12 @@
+#include "llvm-c/ExecutionEngine.h"
+#include "mcjit.h"
+
+#include <stddef.h> /* NULL */
+
+uint64_t GetCountedFunctionAddress(LLVMExecutionEngineRef EE,
+                                   const char *name, PerfEntry **entry)
+{
+  uint64_t addr = LLVMGetFunctionAddress(EE, name);
+  *entry = addr && PerfEnabled() ? PerfRegister(name, addr) : NULL;
+  return addr;
+}
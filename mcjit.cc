@@ -1,4 +1,5 @@
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "codememmgr.h"
 
 extern "C"
 LLVMBool CreateMCJIT(LLVMExecutionEngineRef *OutJIT,
@@ -8,6 +9,8 @@ LLVMBool CreateMCJIT(LLVMExecutionEngineRef *OutJIT,
   if (llvm::ExecutionEngine *EE =
       llvm::EngineBuilder(std::unique_ptr<llvm::Module>(llvm::unwrap(M))).
       setEngineKind(llvm::EngineKind::JIT).
+      setMCJITMemoryManager(std::unique_ptr<llvm::RTDyldMemoryManager>
+                            (new CodeMemManager)).
       setErrorStr(&Error).
       setOptLevel(llvm::CodeGenOpt::Default).
       setRelocationModel(llvm::Reloc::PIC_).
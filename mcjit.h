@@ -1,2 +1,11 @@
+#include "perfcount.h"
+
 LLVMBool CreateMCJIT(LLVMExecutionEngineRef *OutJIT,
                      LLVMModuleRef M, char **OutError);
+/** Look up a function and register it for PerfStart() and PerfStop()
+(defined in mcjit-perf.c).
+@param entry  output: the entry point for PerfStop(), or NULL if not found
+              or if PerfEnable() has not been invoked
+@return the address of the function, or 0 if not found */
+uint64_t GetCountedFunctionAddress(LLVMExecutionEngineRef EE,
+                                   const char *name, PerfEntry **entry);
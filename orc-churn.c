@@ -0,0 +1,145 @@
+/* Churn benchmark: keep adding modules to one long-lived JITDylib while
+removing the oldest ones, each via its own ResourceTracker. Reports the
+add and remove rates and the resident set size, which should remain
+constant once the window of live modules is full. */
+#include "llvm-c/Core.h"
+#include "llvm-c/LLJIT.h"
+#include "llvm-c/OrcEE.h"
+#include "llvm-c/Target.h"
+#include "orc.h"
+#include "rss.h"
+
+#include <stdio.h> /* printf(), snprintf() */
+#include <stdlib.h> /* atoi(), calloc() */
+#include <time.h> /* clock_gettime() */
+
+#define FALSE 0
+#define TRUE 1
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Create a module with int booN(int x) { return abs(x) + N; }
+where abs() is resolved from the current process. */
+static LLVMOrcThreadSafeModuleRef create_module(unsigned n, const char *name)
+{
+  LLVMOrcThreadSafeContextRef TSC = LLVMOrcCreateNewThreadSafeContext();
+  LLVMContextRef C = LLVMOrcThreadSafeContextGetContext(TSC);
+  LLVMModuleRef M = LLVMModuleCreateWithNameInContext(name, C);
+  LLVMTypeRef intType = LLVMInt32TypeInContext(C);
+  LLVMTypeRef FT = LLVMFunctionType(intType, &intType, 1, FALSE);
+  LLVMValueRef Abs = LLVMAddFunction(M, "abs", FT);
+  LLVMValueRef TheFunction = LLVMAddFunction(M, name, FT);
+  LLVMSetLinkage(TheFunction, LLVMExternalLinkage);
+
+  LLVMBuilderRef builder = LLVMCreateBuilderInContext(C);
+  LLVMPositionBuilderAtEnd(builder,
+                           LLVMAppendBasicBlockInContext(C, TheFunction,
+                                                         "entry"));
+  LLVMValueRef x = LLVMGetParam(TheFunction, 0);
+  LLVMValueRef a = LLVMBuildCall2(builder, FT, Abs, &x, 1, "");
+  LLVMBuildRet(builder, LLVMBuildAdd(builder, a,
+                                     LLVMConstInt(intType, n, FALSE), ""));
+  LLVMDisposeBuilder(builder);
+
+  LLVMOrcThreadSafeModuleRef TSM = LLVMOrcCreateNewThreadSafeModule(M, TSC);
+  LLVMOrcDisposeThreadSafeContext(TSC);
+  return TSM;
+}
+
+int main(int argc, char **argv)
+{
+  LLVMInitializeNativeTarget();
+  LLVMInitializeNativeAsmPrinter();
+
+  int count = argc > 1 ? atoi(argv[1]) : 100000;
+  int window = argc > 2 ? atoi(argv[2]) : 1000;
+  int report = argc > 3 ? atoi(argv[3]) : 10000;
+  if (window < 1)
+    window = 1;
+  if (report < 1)
+    report = 1;
+
+  LLVMOrcLLJITRef Jit = NULL;
+  LLVMErrorRef Err;
+  LLVMOrcResourceTrackerRef *live = calloc(window, sizeof *live);
+
+  if ((Err = LLVMOrcCreateLLJIT(&Jit, LLVMOrcCreateLLJITBuilder()))) {
+  err_exit:
+    LLVMOrcDisposeLLJIT(Jit);
+    char *ErrMsg = LLVMGetErrorMessage(Err);
+    fprintf(stderr, "Error: %s\n", ErrMsg);
+    LLVMDisposeErrorMessage(ErrMsg);
+    free(live);
+    return 1;
+  }
+
+  /* The long-lived JITDylib with the shared imports */
+  LLVMOrcJITDylibRef JD = LLVMOrcExecutionSessionCreateBareJITDylib
+    (LLVMOrcLLJITGetExecutionSession(Jit), "<main>");
+  {
+    LLVMOrcDefinitionGeneratorRef DG;
+
+    if ((Err = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess
+         (&DG, LLVMOrcLLJITGetGlobalPrefix(Jit), NULL, NULL)))
+      goto err_exit;
+
+    LLVMOrcJITDylibAddGenerator(JD, DG);
+  }
+
+  printf("modules\tlive\tadd_per_s\tremove_per_s\trss_kb\n");
+
+  double add_time = 0, remove_time = 0;
+  int adds = 0, removes = 0, nlive = 0;
+
+  for (int i = 0; i < count; i++) {
+    char name[32];
+    LLVMOrcJITTargetAddress addr;
+    snprintf(name, sizeof name, "boo%d", i);
+
+    LLVMOrcResourceTrackerRef *slot = &live[i % window];
+    double start = now();
+    if (*slot) {
+      if ((Err = LLVM_RemoveModule(*slot)))
+        goto err_exit;
+      *slot = NULL;
+      nlive--;
+      removes++;
+      remove_time += now() - start;
+      start = now();
+    }
+
+    /* The lookup forces the materialization of the module. */
+    if ((Err = LLVM_AddModule(Jit, JD, create_module(i, name), slot)) ||
+        (Err = LLVM_Lookup(Jit, JD, &addr, name)))
+      goto err_exit;
+    add_time += now() - start;
+    adds++;
+    nlive++;
+
+    if (((int (*)(int)) addr)(-1) != i + 1) {
+      fprintf(stderr, "Error: wrong result from %s\n", name);
+      return 2;
+    }
+
+    if ((i + 1) % report == 0) {
+      printf("%d\t%d\t%.0f\t%.0f\t%ld\n", i + 1, nlive,
+             adds / add_time, removes ? removes / remove_time : 0.0,
+             rss_kb());
+      add_time = remove_time = 0;
+      adds = removes = 0;
+    }
+  }
+
+  for (int i = 0; i < window; i++)
+    if (live[i] && (Err = LLVM_RemoveModule(live[i])))
+      goto err_exit;
+
+  free(live);
+  LLVMOrcDisposeLLJIT(Jit);
+  return 0;
+}
@@ -0,0 +1,13 @@
+#include "llvm-c/LLJIT.h"
+#include "orc.h"
+
+#include <stddef.h> /* NULL */
+
+LLVMErrorRef LLVM_LookupCounted
+(LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcJITTargetAddress *addr,
+ PerfEntry **entry, const char *name)
+{
+  LLVMErrorRef Err = LLVM_Lookup(J, JD, addr, name);
+  *entry = Err || !PerfEnabled() ? NULL : PerfRegister(name, *addr);
+  return Err;
+}
@@ -3,6 +3,8 @@
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/Support/CBindingWrapping.h"
 
+#include <cstring> /* memset() */
+
 DEFINE_SIMPLE_CONVERSION_FUNCTIONS(llvm::orc::LLJIT, LLVMOrcLLJITRef)
 DEFINE_SIMPLE_CONVERSION_FUNCTIONS(llvm::orc::JITDylib, LLVMOrcJITDylibRef)
 
@@ -24,15 +26,57 @@ LLVMErrorRef LLVM_Lookup
   return LLVMErrorSuccess;
 }
 
-#if LLVM_VERSION_MAJOR >= 14
-DEFINE_SIMPLE_CONVERSION_FUNCTIONS(llvm::orc::ExecutionSession,
-                                   LLVMOrcExecutionSessionRef)
+extern "C"
+LLVMErrorRef LLVM_LookupBatch
+(LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcJITTargetAddress *addrs,
+ const char *const *names, size_t count)
+{
+  llvm::orc::LLJIT &Jit = *unwrap(J);
+  std::vector<llvm::orc::SymbolStringPtr> Names;
+  llvm::orc::SymbolLookupSet Symbols;
+  Names.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    Names.push_back(Jit.mangleAndIntern(names[i]));
+    /* A weak reference will not fail the lookup when it is not found. */
+    Symbols.add(Names.back(),
+                llvm::orc::SymbolLookupFlags::WeaklyReferencedSymbol);
+  }
+  Symbols.removeDuplicates();
+
+  auto Syms = Jit.getExecutionSession().lookup
+    (llvm::orc::makeJITDylibSearchOrder
+     (unwrap(JD), llvm::orc::JITDylibLookupFlags::MatchAllSymbols),
+     std::move(Symbols));
+  if (!Syms) {
+    memset(addrs, 0, count * sizeof *addrs);
+    return wrap(Syms.takeError());
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    auto S = Syms->find(Names[i]);
+    addrs[i] = S == Syms->end() ? 0 : S->second.getAddress();
+  }
+  return LLVMErrorSuccess;
+}
 
 extern "C"
-LLVMErrorRef LLVM_Remove(LLVMOrcExecutionSessionRef ES, LLVMOrcJITDylibRef JD)
+LLVMErrorRef LLVM_AddModule
+(LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcThreadSafeModuleRef TSM,
+ LLVMOrcResourceTrackerRef *RT)
 {
-  if (llvm::Error Err{unwrap(ES)->removeJITDylib(*unwrap(JD))})
-    return wrap(std::move(Err));
+  *RT = LLVMOrcJITDylibCreateResourceTracker(JD);
+  if (LLVMErrorRef Err = LLVMOrcLLJITAddLLVMIRModuleWithRT(J, *RT, TSM)) {
+    LLVMOrcReleaseResourceTracker(*RT);
+    *RT = nullptr;
+    return Err;
+  }
   return LLVMErrorSuccess;
 }
-#endif
+
+extern "C"
+LLVMErrorRef LLVM_RemoveModule(LLVMOrcResourceTrackerRef RT)
+{
+  LLVMErrorRef Err = LLVMOrcResourceTrackerRemove(RT);
+  LLVMOrcReleaseResourceTracker(RT);
+  return Err;
+}
@@ -1,6 +1,29 @@
+#include "perfcount.h"
+
 LLVMErrorRef LLVM_Lookup
 (LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcJITTargetAddress *addr,
  const char *name);
-#if LLVM_VERSION_MAJOR >= 14
-LLVMErrorRef LLVM_Remove(LLVMOrcExecutionSessionRef ES, LLVMOrcJITDylibRef JD);
-#endif
+/** Add a module to a JITDylib, tracked by a ResourceTracker of its own.
+@param TSM  the module, which will be consumed (even on error)
+@param RT   output: handle for LLVM_RemoveModule() or
+            LLVMOrcResourceTrackerTransferTo() */
+LLVMErrorRef LLVM_AddModule
+(LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcThreadSafeModuleRef TSM,
+ LLVMOrcResourceTrackerRef *RT);
+/** Free the code and symbols of a module that was added by LLVM_AddModule(),
+without affecting other modules in the JITDylib, and release the handle. */
+LLVMErrorRef LLVM_RemoveModule(LLVMOrcResourceTrackerRef RT);
+/** Look up several symbols by a single lookup in the ExecutionSession.
+@param addrs  output: the addresses, or 0 for symbols that were not found
+@param names  the names of the symbols
+@param count  the number of names */
+LLVMErrorRef LLVM_LookupBatch
+(LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcJITTargetAddress *addrs,
+ const char *const *names, size_t count);
+/** Look up a symbol and register it for PerfStart() and PerfStop()
+(defined in orc-perf.c).
+@param entry  output: the entry point for PerfStop(), or NULL on error
+              or if PerfEnable() has not been invoked */
+LLVMErrorRef LLVM_LookupCounted
+(LLVMOrcLLJITRef J, LLVMOrcJITDylibRef JD, LLVMOrcJITTargetAddress *addr,
+ PerfEntry **entry, const char *name);
@@ -0,0 +1,270 @@
+#include "perfcount.h"
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined __x86_64__ || defined __i386__
+# include <x86intrin.h> /* __rdpmc(), __rdtsc() */
+#endif
+
+#include <atomic>
+#include <cinttypes>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct PerfEntry
+{
+  explicit PerfEntry(uint64_t Addr) : Addr(Addr) {}
+  std::atomic<uint64_t> Addr;
+  std::atomic<uint64_t> Calls{0};
+  std::atomic<uint64_t> Value[PERF_EVENTS]{};
+};
+
+namespace {
+
+/** The perf_event_attr type and config of each PerfEvent */
+const struct { uint32_t Type; uint64_t Config; const char *Name; }
+Events[PERF_EVENTS] = {
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task_clock"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses"},
+  {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_ITLB |
+   PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+   "itlb_misses"},
+};
+
+std::atomic<bool> Enabled{false};
+/** Bitmap of events that could be opened in some thread */
+std::atomic<unsigned> Available{0};
+
+std::mutex RegistryMutex;
+std::map<std::string, std::unique_ptr<PerfEntry>> Registry;
+
+/** The counter group of a thread */
+class ThreadCounters
+{
+public:
+  ThreadCounters()
+  {
+    for (int &fd : Fds)
+      fd = -1;
+    for (int &slot : Slots)
+      slot = -1;
+    for (perf_event_mmap_page *&page : Pages)
+      page = nullptr;
+  }
+
+  ~ThreadCounters()
+  {
+    const long PageSize = sysconf(_SC_PAGESIZE);
+    for (perf_event_mmap_page *page : Pages)
+      if (page)
+        munmap(page, PageSize);
+    for (int fd : Fds)
+      if (fd >= 0)
+        close(fd);
+  }
+
+  /** Read all counters of the group. */
+  void read(PerfReading *R)
+  {
+    if (!Opened)
+      open();
+    if (readUser(R))
+      return;
+    /* nr, time_enabled, time_running, value[nr] */
+    uint64_t Buf[3 + PERF_EVENTS];
+    if (Leader < 0 ||
+        ::read(Leader, Buf, sizeof Buf) < ssize_t(3 * sizeof *Buf))
+      Buf[0] = 0;
+    /* If the kernel multiplexed the counters because there are not
+    enough of them, extrapolate to the time that the group was enabled. */
+    const double Scale = Buf[0] && Buf[2] && Buf[2] < Buf[1]
+      ? double(Buf[1]) / double(Buf[2]) : 1.0;
+    for (unsigned e = 0; e < PERF_EVENTS; e++)
+      R->value[e] = Slots[e] >= 0 && uint64_t(Slots[e]) < Buf[0]
+        ? uint64_t(double(Buf[3 + Slots[e]]) * Scale) : 0;
+  }
+
+private:
+  /** Read all counters of the group without a system call, by RDPMC
+  and the perf_event_mmap_page of each event.
+  @return whether the reading succeeded */
+  bool readUser(PerfReading *R) const
+  {
+#if defined __x86_64__ || defined __i386__
+    if (Leader < 0)
+      return false;
+    for (unsigned e = 0; e < PERF_EVENTS; e++) {
+      R->value[e] = 0;
+      if (Fds[e] < 0)
+        continue;
+      const volatile perf_event_mmap_page *P = Pages[e];
+      if (!P)
+        return false;
+      uint32_t Seq;
+      uint64_t Count, Enabled, Running;
+      do {
+        Seq = P->lock;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        /* Without cap_user_time, the times of a multiplexed group
+        cannot be extrapolated. */
+        if (!P->cap_user_time)
+          return false;
+        const uint64_t Cycles = __rdtsc();
+        const uint16_t Shift = P->time_shift;
+        const uint32_t Mult = P->time_mult;
+        /* the time since the kernel last updated the page */
+        const uint64_t Delta = P->time_offset + (Cycles >> Shift) * Mult +
+          (((Cycles & ((uint64_t{1} << Shift) - 1)) * Mult) >> Shift);
+        const uint32_t Index = P->index;
+        Enabled = P->time_enabled + Delta;
+        Running = P->time_running;
+        Count = P->offset;
+        if (Events[e].Type == PERF_TYPE_SOFTWARE) {
+          /* task_clock counts the time that the thread is running,
+          which is the running time of the event. */
+          Running += Delta;
+          Count += Delta;
+        } else if (P->cap_user_rdpmc && Index) {
+          Running += Delta;
+          const unsigned Width = P->pmc_width;
+          /* Sign-extend the counter to 64 bits. */
+          int64_t PMC = __rdpmc(int(Index - 1));
+          PMC = int64_t(uint64_t(PMC) << (64 - Width)) >> (64 - Width);
+          Count += PMC;
+        } else
+          /* The event is not currently scheduled on a counter. */
+          return false;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+      } while (P->lock != Seq);
+      R->value[e] = Running && Running < Enabled
+        ? uint64_t(double(Count) * double(Enabled) / double(Running))
+        : Count;
+    }
+    return true;
+#else
+    (void) R;
+    return false;
+#endif
+  }
+
+  void open()
+  {
+    Opened = true;
+    unsigned Mask = 0;
+    int n = 0;
+    for (unsigned e = 0; e < PERF_EVENTS; e++) {
+      perf_event_attr A{};
+      A.size = sizeof A;
+      A.type = Events[e].Type;
+      A.config = Events[e].Config;
+      A.exclude_kernel = 1;
+      A.exclude_hv = 1;
+      A.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+        PERF_FORMAT_TOTAL_TIME_RUNNING;
+      /* The first event that can be opened becomes the group leader. */
+      Fds[e] = int(syscall(SYS_perf_event_open, &A, 0, -1, Leader, 0));
+      if (Fds[e] < 0)
+        continue;
+      if (Leader < 0)
+        Leader = Fds[e];
+      Slots[e] = n++;
+      void *Page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ,
+                        MAP_SHARED, Fds[e], 0);
+      if (Page != MAP_FAILED)
+        Pages[e] = static_cast<perf_event_mmap_page*>(Page);
+      Mask |= 1U << e;
+    }
+    Available.fetch_or(Mask, std::memory_order_relaxed);
+  }
+
+  bool Opened = false;
+  int Leader = -1;
+  /** file descriptor of each event, or -1 */
+  int Fds[PERF_EVENTS];
+  /** position of each event in the group reading, or -1 */
+  int Slots[PERF_EVENTS];
+  /** the mapped page of each event for readUser(), or nullptr */
+  perf_event_mmap_page *Pages[PERF_EVENTS];
+};
+
+thread_local ThreadCounters Counters;
+
+} // namespace
+
+extern "C" void PerfEnable(void)
+{
+  Enabled.store(true, std::memory_order_relaxed);
+}
+
+extern "C" int PerfEnabled(void)
+{
+  return Enabled.load(std::memory_order_relaxed);
+}
+
+extern "C" PerfEntry *PerfRegister(const char *name, uint64_t addr)
+{
+  std::lock_guard<std::mutex> Lock{RegistryMutex};
+  std::unique_ptr<PerfEntry> &E = Registry[name];
+  if (E)
+    E->Addr.store(addr, std::memory_order_relaxed);
+  else
+    E.reset(new PerfEntry(addr));
+  return E.get();
+}
+
+extern "C" void PerfStart(PerfReading *start)
+{
+  if (Enabled.load(std::memory_order_relaxed))
+    Counters.read(start);
+  else
+    /* If PerfEnable() is invoked before PerfStop(), the call will not
+    be counted. */
+    *start = PerfReading{};
+}
+
+extern "C" void PerfStop(PerfEntry *entry, const PerfReading *start)
+{
+  if (!entry || !Enabled.load(std::memory_order_relaxed))
+    return;
+  bool Started = false;
+  for (uint64_t v : start->value)
+    Started |= v != 0;
+  if (!Started)
+    return;
+  PerfReading stop;
+  Counters.read(&stop);
+  entry->Calls.fetch_add(1, std::memory_order_relaxed);
+  for (unsigned e = 0; e < PERF_EVENTS; e++)
+    /* Scaled readings are estimates and might decrease. */
+    if (stop.value[e] > start->value[e])
+      entry->Value[e].fetch_add(stop.value[e] - start->value[e],
+                                std::memory_order_relaxed);
+}
+
+extern "C" void PerfDump(FILE *f)
+{
+  const unsigned Mask = Available.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> Lock{RegistryMutex};
+  fputs("symbol\taddress\tcalls", f);
+  for (const auto &Event : Events)
+    fprintf(f, "\t%s", Event.Name);
+  fputc('\n', f);
+  for (const auto &E : Registry) {
+    const PerfEntry &P = *E.second;
+    fprintf(f, "%s\t%#" PRIx64 "\t%" PRIu64, E.first.c_str(),
+            P.Addr.load(std::memory_order_relaxed),
+            P.Calls.load(std::memory_order_relaxed));
+    for (unsigned e = 0; e < PERF_EVENTS; e++)
+      if (Mask & 1U << e)
+        fprintf(f, "\t%" PRIu64, P.Value[e].load(std::memory_order_relaxed));
+      else
+        fputs("\t-", f);
+    fputc('\n', f);
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+/* Hardware performance counters around calls of JIT entry points.
+Each thread that invokes PerfStart() opens its own group of counters by
+perf_event_open(2) on first use. The counters keep running; PerfStart()
+and PerfStop() each read the whole group, by RDPMC where the kernel
+allows it and otherwise by one read(2) system call, and accumulate the
+difference per registered entry point. If the kernel
+multiplexes the counters, the readings are scaled by the ratio of the
+enabled and running time of the group. Everything is a no-op until
+PerfEnable() has been invoked. */
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The counted events */
+enum PerfEvent
+{
+  /** CPU time of the thread in nanoseconds (software event) */
+  PERF_TASK_CLOCK,
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_ITLB_MISSES,
+  PERF_EVENTS
+};
+
+/** A reading of the counters of the current thread */
+typedef struct PerfReading
+{
+  uint64_t value[PERF_EVENTS];
+} PerfReading;
+
+/** The accumulated counters of an entry point */
+typedef struct PerfEntry PerfEntry;
+
+/** Enable the counting in all threads. */
+void PerfEnable(void);
+
+/** @return nonzero if PerfEnable() was invoked */
+int PerfEnabled(void);
+
+/** Register a JIT entry point. Registering the same name again
+will update the address and keep the accumulated counters.
+@return the entry point */
+PerfEntry *PerfRegister(const char *name, uint64_t addr);
+
+/** Read the counters of the current thread before a call.
+If the counting is disabled, the reading will be zero, and a subsequent
+PerfStop() will not count anything. */
+void PerfStart(PerfReading *start);
+
+/** Accumulate the counters of the current thread after a call.
+@param entry  the result of PerfRegister(), or NULL to count nothing
+@param start  the result of PerfStart() */
+void PerfStop(PerfEntry *entry, const PerfReading *start);
+
+/** Write the number of calls and the accumulated counters of each
+registered entry point as a table. Events that could not be opened
+(for example, hardware events in a virtual machine) are shown as "-". */
+void PerfDump(FILE *f);
+
+#ifdef __cplusplus
+}
+
+/** Accumulate the counters of the current thread during the lifetime
+of the object. */
+class PerfScope
+{
+public:
+  explicit PerfScope(PerfEntry *E) : E(E) { PerfStart(&Start); }
+  ~PerfScope() { PerfStop(E, &Start); }
+
+private:
+  PerfEntry *const E;
+  PerfReading Start;
+};
+#endif
+#endif
@@ -0,0 +1,386 @@
+#include "profile.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/ProfileSummary.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Instrumentation.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/CallPromotionUtils.h"
+
+#include <algorithm> /* std::sort() */
+#include <cstring> /* memcmp(), memcpy() */
+#include <dlfcn.h> /* dladdr() */
+
+#if LLVM_VERSION_MAJOR < 10
+namespace llvm { using Align = int; }
+#endif
+
+namespace
+{
+/** A counted location: the entry of a function, an edge, or an
+indirect call */
+struct ProfileSite
+{
+  llvm::BasicBlock *BB;
+  /** successor number of BB, or ENTRY for the entry of the function,
+  or CALL for an indirect call */
+  unsigned Succ;
+  /** the indirect call (CALL) */
+  llvm::CallBase *Call;
+  static constexpr unsigned ENTRY = ~0U;
+  static constexpr unsigned CALL = ~1U;
+  /** number of targets that are counted for an indirect call */
+  static constexpr unsigned TARGETS = 3;
+  /** number of counters of an indirect call: the number of calls,
+  followed by TARGETS pairs of target and count */
+  static constexpr unsigned CALL_SIZE = 1 + 2 * TARGETS;
+
+  /** @return the number of counters of the site */
+  size_t size() const { return Succ == CALL ? CALL_SIZE : 1; }
+};
+}
+
+/** Enumerate the counted locations. Each function contributes its entry,
+followed by all indirect calls and outgoing edges of conditional branches
+and switches of each block. The order only depends on the original (not
+instrumented) module. */
+static std::vector<ProfileSite> getProfileSites(llvm::Module &M)
+{
+  std::vector<ProfileSite> Sites;
+  for (llvm::Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    Sites.push_back({&F.getEntryBlock(), ProfileSite::ENTRY});
+    for (llvm::BasicBlock &BB : F) {
+      for (llvm::Instruction &I : BB)
+        if (auto CB = llvm::dyn_cast<llvm::CallBase>(&I))
+          if (CB->isIndirectCall())
+            Sites.push_back({&BB, ProfileSite::CALL, CB});
+      const llvm::Instruction *TI = BB.getTerminator();
+      if (!TI || TI->getNumSuccessors() < 2 ||
+          !(llvm::isa<llvm::BranchInst>(TI) || llvm::isa<llvm::SwitchInst>(TI)))
+        continue;
+      for (unsigned i = 0; i < TI->getNumSuccessors(); i++)
+        Sites.push_back({&BB, i});
+    }
+  }
+  return Sites;
+}
+
+/** @return the total number of counters of the sites */
+static size_t getProfileSize(const std::vector<ProfileSite> &Sites)
+{
+  size_t Size = 0;
+  for (const ProfileSite &Site : Sites)
+    Size += Site.size();
+  return Size;
+}
+
+/** Count a call at an instrumented indirect call site.
+@param Site    the counters of the site (see ProfileSite::CALL_SIZE)
+@param Target  the called function */
+static void recordTarget(uint64_t *Site, const void *Target)
+{
+  Site[0]++;
+  const uint64_t T = reinterpret_cast<uintptr_t>(Target);
+  for (unsigned i = 1; i < ProfileSite::CALL_SIZE; i += 2)
+    if (Site[i] == T || !Site[i + 1]) {
+      Site[i] = T;
+      Site[i + 1]++;
+      return;
+    }
+  /* All slots are taken by other targets; only count the call. */
+}
+
+ProfileCounters instrumentProfile(llvm::Module &M, llvm::StringRef Hash)
+{
+  const std::vector<ProfileSite> Sites{getProfileSites(M)};
+  ProfileCounters P{"__hellovm_prof_" + Hash.str(), getProfileSize(Sites),
+                    {}};
+
+  const auto int64Type = llvm::Type::getInt64Ty(M.getContext());
+  const auto countersType = llvm::ArrayType::get(int64Type, P.Size);
+  auto GV = new llvm::GlobalVariable(M, countersType, false,
+                                     llvm::GlobalValue::ExternalLinkage,
+                                     llvm::ConstantAggregateZero::get
+                                     (countersType), P.Name);
+  GV->setAlignment(llvm::Align(8));
+
+  /* Indirect calls are counted by recordTarget(), which is invoked by
+  its address in this process. */
+  const auto stringType = llvm::Type::getInt8PtrTy(M.getContext());
+  const auto recordType =
+    llvm::FunctionType::get(llvm::Type::getVoidTy(M.getContext()),
+                            {int64Type->getPointerTo(), stringType}, false);
+  const auto record = llvm::ConstantExpr::getIntToPtr
+    (llvm::ConstantInt::get(int64Type,
+                            reinterpret_cast<uintptr_t>(&recordTarget)),
+     recordType->getPointerTo());
+
+  for (size_t i = 0, c = 0; i < Sites.size(); c += Sites[i++].size()) {
+    llvm::BasicBlock *BB = Sites[i].BB;
+    if (llvm::CallBase *CB = Sites[i].Call) {
+      P.Targets.push_back(c);
+      llvm::IRBuilder<> builder(CB);
+      builder.CreateCall(llvm::FunctionCallee{recordType, record},
+                         {builder.CreateConstInBoundsGEP2_64
+                          (countersType, GV, 0, c),
+                          builder.CreatePointerCast(CB->getCalledOperand(),
+                                                    stringType)});
+      continue;
+    }
+    if (Sites[i].Succ != ProfileSite::ENTRY) {
+      llvm::Instruction *TI = BB->getTerminator();
+      /* The successor of a non-critical edge has no other predecessor. */
+      BB = llvm::isCriticalEdge(TI, Sites[i].Succ)
+        ? llvm::SplitCriticalEdge(TI, Sites[i].Succ)
+        : TI->getSuccessor(Sites[i].Succ);
+      if (!BB)
+        continue; /* The edge cannot be split; its counter will remain 0. */
+    }
+    llvm::IRBuilder<> builder(&*BB->getFirstInsertionPt());
+    auto Ptr = builder.CreateConstInBoundsGEP2_64(countersType, GV, 0, c);
+    builder.CreateStore(builder.CreateAdd(builder.CreateLoad(int64Type, Ptr),
+                                          builder.getInt64(1)), Ptr);
+  }
+
+  return P;
+}
+
+std::vector<uint64_t> readProfile(uint64_t Addr, const ProfileCounters &P)
+{
+  const uint64_t *Counters = reinterpret_cast<const uint64_t*>(Addr);
+  std::vector<uint64_t> Profile(Counters, Counters + P.Size);
+  for (size_t Site : P.Targets)
+    for (unsigned i = 1; i < ProfileSite::CALL_SIZE; i += 2) {
+      uint64_t &Target = Profile[Site + i];
+      void *const Function = reinterpret_cast<void*>(Target);
+      Dl_info Info;
+      if (Profile[Site + i + 1] && dladdr(Function, &Info) &&
+          Info.dli_sname && Info.dli_saddr == Function)
+        Target = llvm::MD5Hash(Info.dli_sname);
+      else
+        Target = Profile[Site + i + 1] = 0;
+    }
+  return Profile;
+}
+
+/** Merge the targets of an indirect call site of two profiles,
+keeping the most frequent ones.
+@param Sum  output: the merged counters, with the number of calls set */
+static void mergeTargets(uint64_t *Sum, const uint64_t *A, const uint64_t *B)
+{
+  /* pairs of count and target */
+  std::vector<std::pair<uint64_t, uint64_t>> Targets;
+  for (const uint64_t *Site : {A, B})
+    for (unsigned i = 1; i < ProfileSite::CALL_SIZE; i += 2) {
+      if (!Site[i + 1])
+        continue;
+      auto T = std::find_if(Targets.begin(), Targets.end(),
+                            [&](const std::pair<uint64_t, uint64_t> &T)
+                            { return T.second == Site[i]; });
+      if (T == Targets.end())
+        Targets.emplace_back(Site[i + 1], Site[i]);
+      else
+        T->first += Site[i + 1];
+    }
+  std::sort(Targets.rbegin(), Targets.rend());
+  for (unsigned i = 0; i < ProfileSite::TARGETS; i++) {
+    const bool Found = i < Targets.size();
+    Sum[1 + 2 * i] = Found ? Targets[i].second : 0;
+    Sum[2 + 2 * i] = Found ? Targets[i].first : 0;
+  }
+}
+
+static const char ProfileMagic[8] = {'H','L','V','M','P','R','O','F'};
+
+static std::string getProfilePath(llvm::StringRef Dir, llvm::StringRef Hash)
+{
+  llvm::SmallString<128> Path{Dir};
+  llvm::sys::path::append(Path, Hash + ".prof");
+  return Path.str().str();
+}
+
+llvm::Error saveProfile(llvm::StringRef Dir, llvm::StringRef Hash,
+                        const ProfileCounters &P,
+                        llvm::ArrayRef<uint64_t> Counters)
+{
+  std::vector<uint64_t> Sum{Counters.begin(), Counters.end()};
+  llvm::Expected<std::vector<uint64_t>> Old{loadProfile(Dir, Hash)};
+  if (!Old)
+    llvm::consumeError(Old.takeError());
+  else if (Old->size() == Sum.size()) {
+    for (size_t i = 0; i < Sum.size(); i++)
+      Sum[i] += (*Old)[i];
+    for (size_t Site : P.Targets)
+      mergeTargets(&Sum[Site], &(*Old)[Site], &Counters[Site]);
+  }
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS{getProfilePath(Dir, Hash), EC};
+  if (EC)
+    return llvm::errorCodeToError(EC);
+  OS.write(ProfileMagic, sizeof ProfileMagic);
+  OS.write(reinterpret_cast<const char*>(Sum.data()),
+           Sum.size() * sizeof *Sum.data());
+  OS.close();
+  if (OS.has_error()) {
+    EC = OS.error();
+    OS.clear_error();
+    return llvm::errorCodeToError(EC);
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<std::vector<uint64_t>> loadProfile(llvm::StringRef Dir,
+                                                  llvm::StringRef Hash)
+{
+  const std::string Path{getProfilePath(Dir, Hash)};
+  auto Buf = llvm::MemoryBuffer::getFile(Path);
+  if (!Buf)
+    return llvm::errorCodeToError(Buf.getError());
+
+  llvm::StringRef Data{(*Buf)->getBuffer()};
+  if (Data.size() < sizeof ProfileMagic ||
+      memcmp(Data.data(), ProfileMagic, sizeof ProfileMagic) ||
+      (Data.size() - sizeof ProfileMagic) % sizeof(uint64_t))
+    return llvm::make_error<llvm::StringError>
+      (Path + ": not a profile", llvm::inconvertibleErrorCode());
+
+  std::vector<uint64_t> Counters((Data.size() - sizeof ProfileMagic) /
+                                 sizeof(uint64_t));
+  memcpy(Counters.data(), Data.data() + sizeof ProfileMagic,
+         Counters.size() * sizeof(uint64_t));
+  return Counters;
+}
+
+/** Promote an indirect call to a conditional direct call of its most
+frequent target, if that is the target of most calls and a function of
+the module.
+@param VDs    the targets, most frequent first
+@param Total  the number of calls */
+static void promoteTarget(llvm::Module &M, llvm::CallBase &CB,
+                          llvm::ArrayRef<InstrProfValueData> VDs,
+                          uint64_t Total)
+{
+  if (VDs.empty() || VDs[0].Count <= Total / 2)
+    return;
+  for (llvm::Function &F : M) {
+    if (llvm::MD5Hash(F.getName()) != VDs[0].Value)
+      continue;
+    if (!llvm::isLegalToPromote(CB, &F))
+      return;
+    llvm::pgo::promoteIndirectCall(CB, &F, VDs[0].Count, Total, true,
+                                   nullptr);
+    /* The remaining indirect call will only reach the other targets. */
+    CB.setMetadata(llvm::LLVMContext::MD_prof, nullptr);
+    if (VDs.size() > 1)
+      llvm::annotateValueSite(M, CB, VDs.drop_front(), Total - VDs[0].Count,
+                              llvm::IPVK_IndirectCallTarget,
+                              ProfileSite::TARGETS);
+    return;
+  }
+}
+
+llvm::Error applyProfile(llvm::Module &M, llvm::ArrayRef<uint64_t> Counters)
+{
+  const std::vector<ProfileSite> Sites{getProfileSites(M)};
+  if (getProfileSize(Sites) != Counters.size())
+    return llvm::make_error<llvm::StringError>
+      ("profile does not match " + M.getModuleIdentifier(),
+       llvm::inconvertibleErrorCode());
+
+  llvm::MDBuilder MDB{M.getContext()};
+  llvm::InstrProfSummaryBuilder Summary
+    {llvm::ProfileSummaryBuilder::DefaultCutoffs};
+
+  /* Promoting a call splits its block, which would invalidate the
+  edges of subsequent sites; promote after all sites were annotated. */
+  struct Promotion
+  {
+    llvm::CallBase *CB;
+    std::vector<InstrProfValueData> VDs;
+    uint64_t Total;
+  };
+  std::vector<Promotion> Promotions;
+
+  for (size_t i = 0, c = 0; i < Sites.size(); ) {
+    assert(Sites[i].Succ == ProfileSite::ENTRY);
+    llvm::Function *F = Sites[i++].BB->getParent();
+    std::vector<uint64_t> Counts{Counters[c++]};
+    F->setEntryCount(Counts[0]);
+
+    while (i < Sites.size() && Sites[i].Succ != ProfileSite::ENTRY) {
+      if (llvm::CallBase *CB = Sites[i].Call) {
+        i++;
+        const uint64_t *Site = &Counters[c];
+        c += ProfileSite::CALL_SIZE;
+        std::vector<InstrProfValueData> VDs;
+        for (unsigned t = 1; t < ProfileSite::CALL_SIZE; t += 2)
+          if (Site[t + 1])
+            VDs.push_back({Site[t], Site[t + 1]});
+        if (VDs.empty())
+          continue;
+        std::sort(VDs.begin(), VDs.end(),
+                  [](const InstrProfValueData &A,
+                     const InstrProfValueData &B)
+                  { return A.Count > B.Count; });
+        llvm::annotateValueSite(M, *CB, VDs, Site[0],
+                                llvm::IPVK_IndirectCallTarget,
+                                ProfileSite::TARGETS);
+        Promotions.push_back({CB, std::move(VDs), Site[0]});
+        continue;
+      }
+      llvm::Instruction *TI = Sites[i].BB->getTerminator();
+      const unsigned n = TI->getNumSuccessors();
+      const llvm::ArrayRef<uint64_t> Edges{&Counters[c], n};
+      i += n;
+      c += n;
+      Counts.insert(Counts.end(), Edges.begin(), Edges.end());
+
+      /* Branch weights are 32-bit; scale them down if needed. */
+      const uint64_t Max = *std::max_element(Edges.begin(), Edges.end());
+      if (!Max)
+        continue;
+      const uint64_t Scale = Max / UINT32_MAX + 1;
+      std::vector<uint32_t> Weights;
+      for (uint64_t Count : Edges)
+        Weights.push_back(uint32_t(Count / Scale));
+      TI->setMetadata(llvm::LLVMContext::MD_prof,
+                      MDB.createBranchWeights(Weights));
+    }
+
+    Summary.addRecord(llvm::InstrProfRecord(std::move(Counts)));
+  }
+
+  for (const Promotion &P : Promotions)
+    promoteTarget(M, *P.CB, P.VDs, P.Total);
+
+  std::unique_ptr<llvm::ProfileSummary> PS{Summary.getSummary()};
+  M.setProfileSummary(PS->getMD(M.getContext()),
+                      llvm::ProfileSummary::PSK_Instr);
+
+  const uint64_t Hot = llvm::ProfileSummaryBuilder::getHotCountThreshold
+    (PS->getDetailedSummary());
+  const uint64_t Cold = llvm::ProfileSummaryBuilder::getColdCountThreshold
+    (PS->getDetailedSummary());
+  for (llvm::Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    const uint64_t Count = F.getEntryCount()->getCount();
+    if (Count && Count >= Hot)
+      F.addFnAttr(llvm::Attribute::Hot);
+    else if (!Count || Count < Cold)
+      F.addFnAttr(llvm::Attribute::Cold);
+  }
+
+  return llvm::Error::success();
+}
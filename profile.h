@@ -0,0 +1,59 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+/* Profile-guided recompilation. A module is first compiled with
+instrumentProfile(), which inserts a counter for the entry of each
+function and for each outgoing edge of a conditional branch or switch,
+and value counters for the most frequent targets of each indirect call.
+After running the code, the counters are saved by saveProfile() in a
+file that is named after getModuleHash() of the original module.
+On a later compilation of the same module, applyProfile() attaches
+function entry counts, branch weights, indirect call targets and
+hot/cold attributes. */
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+
+#include "hash.h"
+
+/** The counters that were inserted by instrumentProfile() */
+struct ProfileCounters
+{
+  /** name of the global array of 64-bit counters */
+  std::string Name;
+  /** number of counters */
+  size_t Size;
+  /** the first counter of each indirect call site: the number of calls,
+  followed by pairs of target and count */
+  std::vector<size_t> Targets;
+};
+
+/** Insert profile counters into a module.
+@param Hash  getModuleHash() of the module, before instrumenting it */
+ProfileCounters instrumentProfile(llvm::Module &M, llvm::StringRef Hash);
+
+/** Read the counters of a loaded instrumented module. The address of
+each indirect call target is replaced with the MD5 hash of its symbol
+name (see llvm::MD5Hash()), like in LLVM value profiles, so that the
+profile will remain valid in another process. Targets that dladdr(3)
+cannot name are omitted.
+@param Addr  address of ProfileCounters::Name */
+std::vector<uint64_t> readProfile(uint64_t Addr, const ProfileCounters &P);
+
+/** Add counters to the profile file Dir/Hash.prof.
+@param P         the result of instrumentProfile()
+@param Counters  the result of readProfile() */
+llvm::Error saveProfile(llvm::StringRef Dir, llvm::StringRef Hash,
+                        const ProfileCounters &P,
+                        llvm::ArrayRef<uint64_t> Counters);
+
+/** Read the profile file Dir/Hash.prof. */
+llvm::Expected<std::vector<uint64_t>> loadProfile(llvm::StringRef Dir,
+                                                  llvm::StringRef Hash);
+
+/** Attach entry counts, branch weights and hot/cold attributes to the
+functions of a module that is not instrumented. Indirect calls are
+annotated with their most frequent targets. If most calls go to a
+function that is declared or defined in the module, the call will be
+promoted to a conditional direct call. */
+llvm::Error applyProfile(llvm::Module &M, llvm::ArrayRef<uint64_t> Counters);
+#endif
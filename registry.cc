@@ -0,0 +1,59 @@
+#include "registry.h"
+#include "hash.h"
+
+#include <chrono>
+
+std::string ModuleRegistry::getCanonicalHash(llvm::Module &M)
+{
+  const std::string Id{M.getModuleIdentifier()};
+  const std::string Source{M.getSourceFileName()};
+  M.setModuleIdentifier("");
+  M.setSourceFileName("");
+  std::string Hash{getModuleHash(M)};
+  M.setModuleIdentifier(Id);
+  M.setSourceFileName(Source);
+  return Hash;
+}
+
+llvm::Expected<RegisteredModule*>
+ModuleRegistry::acquire(std::unique_ptr<llvm::Module> M)
+{
+  S.Requests++;
+  const std::string Hash{getCanonicalHash(*M)};
+
+  auto I = Entries.find(Hash);
+  if (I != Entries.end()) {
+    RegisteredModule &RM = I->second;
+    RM.Refs++;
+    S.Hits++;
+    S.BytesSaved += RM.ObjectSize;
+    S.TimeSaved += RM.CompileTime;
+    return &RM;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  auto Obj = L.compile(*M);
+  if (!Obj)
+    return Obj.takeError();
+  const double CompileTime = std::chrono::duration<double>
+    (std::chrono::steady_clock::now() - start).count();
+  const size_t ObjectSize = (*Obj)->getBufferSize();
+
+  llvm::Expected<LoadedModule*> LM{L.add(std::move(*Obj))};
+  if (!LM)
+    return LM.takeError();
+
+  RegisteredModule &RM = Entries[Hash];
+  RM = RegisteredModule{Hash, *LM, 1, ObjectSize, CompileTime};
+  return &RM;
+}
+
+llvm::Error ModuleRegistry::release(RegisteredModule *RM)
+{
+  assert(RM->Refs);
+  if (--RM->Refs)
+    return llvm::Error::success();
+  LoadedModule *LM = RM->LM;
+  Entries.erase(RM->Hash);
+  return L.remove(LM);
+}
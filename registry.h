@@ -0,0 +1,64 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+#include "llvm/ADT/StringMap.h"
+#include "loader.h"
+
+/** A module that was loaded through ModuleRegistry::acquire() */
+struct RegisteredModule
+{
+  /** the canonical hash of the module */
+  std::string Hash;
+  /** the loaded code */
+  LoadedModule *LM;
+  /** number of acquire() minus number of release() */
+  size_t Refs;
+  /** size of the object file */
+  size_t ObjectSize;
+  /** time for compiling the module, in seconds */
+  double CompileTime;
+};
+
+/** A content-addressed registry of the modules that were loaded by a
+Loader, on the blob or ORC path. A module whose canonical hash matches
+an already loaded one is not compiled again; the existing code is
+shared until the last reference has been released. Not thread-safe. */
+class ModuleRegistry
+{
+public:
+  /** Statistics about acquire() */
+  struct Stats
+  {
+    /** number of acquire() calls */
+    uint64_t Requests = 0;
+    /** number of acquire() calls that found a loaded module */
+    uint64_t Hits = 0;
+    /** total ObjectSize of the hits */
+    uint64_t BytesSaved = 0;
+    /** total CompileTime of the hits */
+    double TimeSaved = 0;
+  };
+
+  explicit ModuleRegistry(Loader &L) : L(L) {}
+
+  /** @return the hash of a module, ignoring its identifier and
+  source file name */
+  static std::string getCanonicalHash(llvm::Module &M);
+
+  /** Look up a module by its canonical hash, or compile and load it.
+  @return the module, whose symbols can be looked up in the Loader */
+  llvm::Expected<RegisteredModule*> acquire(std::unique_ptr<llvm::Module> M);
+
+  /** Release a reference to a module, and unload it on the last one.
+  @param RM  the result of acquire() */
+  llvm::Error release(RegisteredModule *RM);
+
+  const Stats &getStats() const { return S; }
+  /** @return the number of loaded modules */
+  size_t size() const { return Entries.size(); }
+
+private:
+  Loader &L;
+  llvm::StringMap<RegisteredModule> Entries;
+  Stats S;
+};
+#endif
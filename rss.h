@@ -0,0 +1,19 @@
+#ifndef RSS_H
+#define RSS_H
+#include <stdio.h> /* fopen(), fscanf() */
+#include <unistd.h> /* sysconf(_SC_PAGESIZE) */
+
+/** @return the resident set size of the current process in KiB,
+or 0 if /proc/self/statm cannot be read */
+static inline long rss_kb(void)
+{
+  long pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%*s %ld", &pages) != 1)
+      pages = 0;
+    fclose(f);
+  }
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+#endif
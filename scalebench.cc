@@ -0,0 +1,345 @@
+/* Scaling benchmark: compile synthetic modules of 1, 10, 100, ... and
+the maximum number of functions by each engine, and report the time for generating the IR,
+compiling it, linking it and looking up every function, as well as the
+resident set size. Each measurement runs in a child process so that
+the memory usage of one run cannot affect the next one. */
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/Support/TargetSelect.h"
+#include "loader.h"
+#include "rss.h"
+#include "synth.h"
+
+#include <chrono>
+#include <cstdio> /* printf(), perror() */
+#include <cstdlib> /* atoi() */
+#include <cstring> /* strcmp() */
+#include <sys/resource.h> /* getrusage() */
+#include <sys/wait.h> /* waitpid() */
+#include <unistd.h> /* fork() */
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+/** The target of every callbackK() */
+static int callback(int x) { return x - 1; }
+
+/** Resolve every callbackK() for MCJIT */
+class CallbackResolver : public llvm::LegacyJITSymbolResolver
+{
+public:
+  llvm::JITSymbol findSymbol(const std::string &Name) override {
+    if (llvm::StringRef(Name).startswith("callback"))
+      return llvm::JITSymbol(llvm::pointerToJITTargetAddress(&callback),
+                             llvm::JITSymbolFlags::Exported);
+    return nullptr;
+  }
+
+  llvm::JITSymbol findSymbolInLogicalDylib(const std::string &) override {
+    return nullptr;
+  }
+};
+
+/** Record the time when MCJIT finished generating the object */
+class CompileTimer : public llvm::ObjectCache
+{
+public:
+  std::chrono::steady_clock::time_point Compiled;
+
+  void notifyObjectCompiled(const llvm::Module *,
+                            llvm::MemoryBufferRef) override {
+    Compiled = std::chrono::steady_clock::now();
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *)
+    override { return nullptr; }
+};
+
+/** The measurements of one run */
+struct Result
+{
+  const char *Path;
+  double Compile = 0, Link = 0, Lookup = 0;
+  std::vector<uint64_t> Addrs;
+};
+
+static double ms(std::chrono::steady_clock::duration d)
+{
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+/** @return the absolute symbols for all callbacks */
+static llvm::orc::SymbolMap
+getCallbacks(llvm::orc::MangleAndInterner &Mangle, unsigned Callbacks)
+{
+  llvm::orc::SymbolMap Symbols;
+  for (unsigned k = 0; k < Callbacks; k++)
+    Symbols[Mangle(getSynthCallbackName(k))] =
+      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&callback),
+                               llvm::JITSymbolFlags::Exported |
+                               llvm::JITSymbolFlags::Callable);
+  return Symbols;
+}
+
+/** Compile and link a module by Loader.
+@param OptimizeIR  whether to run the O2 pipeline */
+static llvm::Error runLoader(std::unique_ptr<llvm::Module> M,
+                             bool OptimizeIR, const SynthOptions &O,
+                             llvm::ArrayRef<llvm::StringRef> Names,
+                             Result &R)
+{
+  using clock = std::chrono::steady_clock;
+  auto L = Loader::Create();
+  if (!L)
+    return L.takeError();
+  (*L)->setOptimizeIR(OptimizeIR);
+
+  if (O.Callbacks) {
+    llvm::orc::MangleAndInterner Mangle{(*L)->getExecutionSession(),
+                                        M->getDataLayout()};
+    if (llvm::Error Err{(*L)->getMainJITDylib().define
+                        (llvm::orc::absoluteSymbols
+                         (getCallbacks(Mangle, O.Callbacks)))})
+      return Err;
+  }
+
+  auto start = clock::now();
+  auto Obj = (*L)->compile(*M);
+  if (!Obj)
+    return Obj.takeError();
+  auto t1 = clock::now();
+  llvm::Expected<LoadedModule*> LM{(*L)->add(std::move(*Obj))};
+  if (!LM)
+    return LM.takeError();
+  /* The first lookup completes the linking in RTDyldObjectLinkingLayer. */
+  uint64_t Addr;
+  if (llvm::Error Err{(*L)->lookup(Names.take_front(),
+                                   llvm::MutableArrayRef<uint64_t>(Addr))})
+    return Err;
+  auto t2 = clock::now();
+  R.Addrs.resize(Names.size());
+  if (llvm::Error Err{(*L)->lookup(Names, R.Addrs)})
+    return Err;
+  auto t3 = clock::now();
+
+  R.Path = getLoadPathName((*LM)->Path);
+  R.Compile = ms(t1 - start);
+  R.Link = ms(t2 - t1);
+  R.Lookup = ms(t3 - t2);
+  /* Leak the Loader, so that the code remains available until exit. */
+  L->release();
+  return llvm::Error::success();
+}
+
+/** Compile and link a module by LLJIT, without any IR optimization. */
+static llvm::Error runLLJIT(std::unique_ptr<llvm::Module> M,
+                            std::unique_ptr<llvm::LLVMContext> C,
+                            const SynthOptions &O,
+                            llvm::ArrayRef<llvm::StringRef> Names,
+                            Result &R)
+{
+  using clock = std::chrono::steady_clock;
+  auto J = llvm::orc::LLJITBuilder().create();
+  if (!J)
+    return J.takeError();
+
+  llvm::orc::ExecutionSession &ES = (*J)->getExecutionSession();
+  llvm::orc::JITDylib &JD = (*J)->getMainJITDylib();
+  llvm::orc::MangleAndInterner Mangle{ES, (*J)->getDataLayout()};
+  if (O.Callbacks)
+    if (llvm::Error Err{JD.define(llvm::orc::absoluteSymbols
+                                  (getCallbacks(Mangle, O.Callbacks)))})
+      return Err;
+
+  clock::time_point Compiled;
+  (*J)->getIRCompileLayer().setNotifyCompiled
+    ([&Compiled](llvm::orc::MaterializationResponsibility &,
+                 llvm::orc::ThreadSafeModule) { Compiled = clock::now(); });
+
+  auto start = clock::now();
+  if (llvm::Error Err{(*J)->addIRModule
+                      (llvm::orc::ThreadSafeModule(std::move(M),
+                                                   std::move(C)))})
+    return Err;
+  /* The first lookup compiles and links the module. */
+  auto First = ES.lookup(llvm::orc::makeJITDylibSearchOrder(&JD),
+                         Mangle(Names.front()));
+  if (!First)
+    return First.takeError();
+  auto t2 = clock::now();
+
+  llvm::orc::SymbolLookupSet Symbols;
+  std::vector<llvm::orc::SymbolStringPtr> Mangled;
+  for (llvm::StringRef N : Names) {
+    Mangled.push_back(Mangle(N));
+    Symbols.add(Mangled.back());
+  }
+  auto Syms = ES.lookup(llvm::orc::makeJITDylibSearchOrder(&JD),
+                        std::move(Symbols));
+  if (!Syms)
+    return Syms.takeError();
+  R.Addrs.clear();
+  for (const auto &S : Mangled)
+    R.Addrs.push_back((*Syms)[S].getAddress());
+  auto t3 = clock::now();
+
+  R.Path = "lljit";
+  R.Compile = ms(Compiled - start);
+  R.Link = ms(t2 - Compiled);
+  R.Lookup = ms(t3 - t2);
+  J->release();
+  return llvm::Error::success();
+}
+
+/** Compile and link a module by MCJIT, without any IR optimization. */
+static llvm::Error runMCJIT(std::unique_ptr<llvm::Module> M,
+                            llvm::ArrayRef<llvm::StringRef> Names,
+                            Result &R)
+{
+  using clock = std::chrono::steady_clock;
+  std::string Error;
+  CompileTimer Timer;
+
+  auto start = clock::now();
+  auto EE = llvm::EngineBuilder(std::move(M)).
+    setEngineKind(llvm::EngineKind::JIT).
+    setSymbolResolver(std::make_unique<CallbackResolver>()).
+    setErrorStr(&Error).
+    setOptLevel(llvm::CodeGenOpt::Default).
+    setRelocationModel(llvm::Reloc::PIC_).
+    create();
+  if (!EE)
+    return llvm::make_error<llvm::StringError>(Error,
+                                               llvm::inconvertibleErrorCode());
+  EE->setObjectCache(&Timer);
+  EE->finalizeObject();
+  if (EE->hasError())
+    return llvm::make_error<llvm::StringError>(EE->getErrorMessage(),
+                                               llvm::inconvertibleErrorCode());
+  auto t2 = clock::now();
+
+  R.Addrs.clear();
+  for (llvm::StringRef N : Names)
+    R.Addrs.push_back(EE->getFunctionAddress(N.str()));
+  auto t3 = clock::now();
+
+  /* The ExecutionEngine is leaked, like the Loader and LLJIT. */
+  EE->setObjectCache(nullptr);
+  R.Path = "mcjit";
+  R.Compile = ms(Timer.Compiled - start);
+  R.Link = ms(t2 - Timer.Compiled);
+  R.Lookup = ms(t3 - t2);
+  return llvm::Error::success();
+}
+
+/** Generate, compile, link and invoke a module, and report the results.
+@return exit status */
+static int run(const std::string &Engine, const SynthOptions &O)
+{
+  using clock = std::chrono::steady_clock;
+  std::vector<std::string> Strings;
+  std::vector<llvm::StringRef> Names;
+  for (unsigned i = 0; i < O.Functions; i++)
+    Strings.push_back(getSynthName(i));
+  Names.assign(Strings.begin(), Strings.end());
+
+  auto C = std::make_unique<llvm::LLVMContext>();
+  auto start = clock::now();
+  auto M = createSynthModule(*C, O);
+  auto t1 = clock::now();
+
+  auto JTMB = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!JTMB) {
+    llvm::errs() << JTMB.takeError() << '\n';
+    return 1;
+  }
+  auto DL = JTMB->getDefaultDataLayoutForTarget();
+  if (!DL) {
+    llvm::errs() << DL.takeError() << '\n';
+    return 1;
+  }
+  M->setDataLayout(*DL);
+
+  Result R;
+  llvm::Error Err{llvm::Error::success()};
+  if (Engine == "loader" || Engine == "loader-noopt")
+    Err = runLoader(std::move(M), Engine == "loader", O, Names, R);
+  else if (Engine == "lljit")
+    Err = runLLJIT(std::move(M), std::move(C), O, Names, R);
+  else if (Engine == "mcjit")
+    Err = runMCJIT(std::move(M), Names, R);
+  else
+    Err = llvm::make_error<llvm::StringError>("unknown engine " + Engine,
+                                              llvm::inconvertibleErrorCode());
+  if (Err) {
+    llvm::errs() << Err << '\n';
+    return 1;
+  }
+
+  uint32_t checksum = 0;
+  for (unsigned i = 0; i < O.Functions; i++) {
+    if (!R.Addrs[i]) {
+      llvm::errs() << "symbol not found: " << Names[i] << '\n';
+      return 1;
+    }
+    checksum += reinterpret_cast<int(*)(int)>(R.Addrs[i])(i);
+  }
+
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  printf("%s\t%u\t%s\t%.2f\t%.2f\t%.2f\t%.2f\t%ld\t%ld\t%08x\n",
+         Engine.c_str(), O.Functions, R.Path, ms(t1 - start), R.Compile,
+         R.Link, R.Lookup, rss_kb(), ru.ru_maxrss, checksum);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  const char *engine = argc > 1 ? argv[1] : "all";
+  unsigned max = argc > 2 ? atoi(argv[2]) : 100000;
+  SynthOptions O;
+  if (argc > 3)
+    O.BodySize = atoi(argv[3]);
+  if (argc > 4)
+    O.Globals = atoi(argv[4]);
+  if (argc > 5)
+    O.Callbacks = atoi(argv[5]);
+
+  std::vector<std::string> Engines;
+  if (!strcmp(engine, "all"))
+    Engines = {"loader", "loader-noopt", "lljit", "mcjit"};
+  else
+    Engines = {engine};
+
+  printf("engine\tfunctions\tpath\tgen_ms\tcompile_ms\tlink_ms\tlookup_ms\t"
+         "rss_kb\tpeak_kb\tchecksum\n");
+  fflush(stdout);
+
+  for (const std::string &E : Engines)
+    for (unsigned n = 1;; n = n > max / 10 ? max : n * 10) {
+      O.Functions = n;
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        return 1;
+      }
+      if (!pid) {
+        int status = run(E, O);
+        fflush(stdout);
+        _exit(status);
+      }
+      int status;
+      if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+          WEXITSTATUS(status))
+        return 1;
+      if (n >= max)
+        break;
+    }
+
+  return 0;
+}
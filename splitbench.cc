@@ -0,0 +1,76 @@
+/* Compare the wall-clock time for compiling one large module on a single
+thread with splitting it into parts and generating code for them
+concurrently (see Loader::compile(M, Threads)). */
+#include "llvm/Support/TargetSelect.h"
+#include "loader.h"
+#include "synth.h"
+
+#include <chrono>
+#include <cstdio> /* printf() */
+#include <cstdlib> /* atoi() */
+
+int main(int argc, char **argv)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  SynthOptions O;
+  O.Functions = argc > 1 ? atoi(argv[1]) : 10000;
+  unsigned max = argc > 2 ? atoi(argv[2]) : 8;
+  if (argc > 3)
+    O.BodySize = atoi(argv[3]);
+
+  std::vector<std::string> Strings;
+  for (unsigned i = 0; i < O.Functions; i++)
+    Strings.push_back(getSynthName(i));
+  std::vector<llvm::StringRef> Names(Strings.begin(), Strings.end());
+  std::vector<uint64_t> Addrs(Names.size());
+
+  printf("threads\tcompile_ms\tlink_ms\tchecksum\n");
+
+  for (unsigned threads = 1; threads <= max; threads++) {
+    using clock = std::chrono::steady_clock;
+    auto L = Loader::Create();
+    if (!L) {
+      llvm::errs() << L.takeError() << '\n';
+      return 1;
+    }
+
+    llvm::LLVMContext C;
+    auto M = createSynthModule(C, O);
+
+    auto start = clock::now();
+    auto Objs = (*L)->compile(*M, threads);
+    if (!Objs) {
+      llvm::errs() << Objs.takeError() << '\n';
+      return 1;
+    }
+    auto t1 = clock::now();
+    llvm::Expected<LoadedModule*> LM{(*L)->add(std::move(*Objs))};
+    if (!LM) {
+      llvm::errs() << LM.takeError() << '\n';
+      return 1;
+    }
+    if (llvm::Error Err{(*L)->lookup(Names, Addrs)}) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+    auto t2 = clock::now();
+
+    uint32_t checksum = 0;
+    for (unsigned i = 0; i < O.Functions; i++) {
+      if (!Addrs[i]) {
+        llvm::errs() << "symbol not found: " << Names[i] << '\n';
+        return 1;
+      }
+      checksum += reinterpret_cast<int(*)(int)>(Addrs[i])(i);
+    }
+
+    using ms = std::chrono::duration<double, std::milli>;
+    printf("%u\t%.2f\t%.2f\t%08x\n", threads, ms(t1 - start).count(),
+           ms(t2 - t1).count(), checksum);
+    fflush(stdout);
+  }
+
+  return 0;
+}
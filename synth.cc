@@ -0,0 +1,100 @@
+#include "synth.h"
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+#if LLVM_VERSION_MAJOR < 10
+namespace llvm { using Align = int; }
+#endif
+
+std::string getSynthName(unsigned I)
+{
+  return "f" + std::to_string(I);
+}
+
+std::string getSynthCallbackName(unsigned K)
+{
+  return "callback" + std::to_string(K);
+}
+
+std::unique_ptr<llvm::Module> createSynthModule(llvm::LLVMContext &C,
+                                                const SynthOptions &O)
+{
+  auto M = std::make_unique<llvm::Module>("synth", C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionType *FT = llvm::FunctionType::get(intType, {intType}, false);
+
+  std::vector<llvm::GlobalVariable*> Globals;
+  for (unsigned j = 0; j < O.Globals; j++) {
+    char world[6], all[6];
+    snprintf(world, sizeof world, "w%04u", j % 10000);
+    snprintf(all, sizeof all, "a%04u", j % 10000);
+    const auto w =
+      llvm::ConstantDataArray::getString(C, llvm::StringRef{world, 6}, false);
+    const auto a =
+      llvm::ConstantDataArray::getString(C, llvm::StringRef{all, 6}, false);
+    const auto greetings =
+      llvm::ConstantArray::get(llvm::ArrayType::get(w->getType(), 2), {w, a});
+    auto GV = new llvm::GlobalVariable(*M, greetings->getType(), true,
+                                       llvm::GlobalValue::ExternalLinkage,
+                                       greetings,
+                                       "greetings" + std::to_string(j));
+    GV->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Local);
+    GV->setAlignment(llvm::Align(1));
+    Globals.push_back(GV);
+  }
+
+  std::vector<llvm::FunctionCallee> Callbacks;
+  for (unsigned k = 0; k < O.Callbacks; k++)
+    Callbacks.push_back(M->getOrInsertFunction(getSynthCallbackName(k), FT));
+
+  for (unsigned i = 0; i < O.Functions; i++) {
+    llvm::Function *TheFunction =
+      llvm::Function::Create(FT, llvm::Function::ExternalLinkage,
+                             getSynthName(i), M.get());
+    TheFunction->setDoesNotThrow();
+
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(C, "entry",
+                                                       TheFunction));
+    llvm::Value *x = TheFunction->arg_begin();
+
+    /* A dependency chain that cannot be folded: alternate between
+    multiplying, adding and shifting, with constants that depend on i. */
+    for (unsigned b = 0; b < O.BodySize; b++) {
+      switch (b % 3) {
+      case 0:
+        x = builder.CreateMul(x, builder.getInt32(2 * (i + b) + 3));
+        break;
+      case 1:
+        x = builder.CreateAdd(x, builder.getInt32(i ^ b));
+        break;
+      case 2:
+        x = builder.CreateXor(x, builder.CreateLShr(x, 1 + (i + b) % 15));
+        break;
+      }
+    }
+
+    if (!Globals.empty()) {
+      /* greetingsJ[x & 1][i % 6] */
+      llvm::GlobalVariable *GV = Globals[i % Globals.size()];
+      auto idx = builder.CreateAnd(x, builder.getInt32(1));
+      auto p = builder.CreateInBoundsGEP(GV->getValueType(), GV,
+                                         {builder.getInt32(0), idx,
+                                          builder.getInt32(i % 6)});
+      auto c = builder.CreateLoad(builder.getInt8Ty(), p);
+      x = builder.CreateAdd(x, builder.CreateZExt(c, intType));
+    }
+
+    if (!Callbacks.empty())
+      x = builder.CreateCall(Callbacks[i % Callbacks.size()], x);
+
+    builder.CreateRet(x);
+  }
+
+  return M;
+}
@@ -0,0 +1,31 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+/* A generator of synthetic modules of configurable size, for measuring
+how compilation, linking and symbol lookup scale. */
+#include "llvm/IR/Module.h"
+
+/** The shape of a module that is created by createSynthModule() */
+struct SynthOptions
+{
+  /** number of functions int fI(int x), named by getSynthName() */
+  unsigned Functions = 1;
+  /** number of arithmetic operations in each function */
+  unsigned BodySize = 4;
+  /** number of constant arrays like "greetings", named greetingsJ,
+  each of which is read by some of the functions */
+  unsigned Globals = 0;
+  /** number of external functions int callbackK(int), each of which
+  is invoked by some of the functions */
+  unsigned Callbacks = 0;
+};
+
+/** @return the name of the I-th function */
+std::string getSynthName(unsigned I);
+
+/** @return the name of the K-th callback */
+std::string getSynthCallbackName(unsigned K);
+
+/** Create a module according to the options. */
+std::unique_ptr<llvm::Module> createSynthModule(llvm::LLVMContext &C,
+                                                const SynthOptions &O);
+#endif
@@ -0,0 +1,77 @@
+#include "template.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+ModuleTemplate::ModuleTemplate(std::unique_ptr<llvm::Module> M) :
+  M(std::move(M))
+{
+  llvm::raw_svector_ostream OS(Bitcode);
+  llvm::WriteBitcodeToFile(*this->M, OS);
+}
+
+llvm::Expected<std::unique_ptr<ModuleTemplate>>
+ModuleTemplate::load(llvm::StringRef Path, llvm::LLVMContext &C)
+{
+  auto Buf = llvm::MemoryBuffer::getFile(Path);
+  if (!Buf)
+    return llvm::errorCodeToError(Buf.getError());
+  llvm::Expected<std::unique_ptr<llvm::Module>> M
+    {llvm::parseBitcodeFile((*Buf)->getMemBufferRef(), C)};
+  if (!M)
+    return M.takeError();
+  return std::unique_ptr<ModuleTemplate>(new ModuleTemplate(std::move(*M)));
+}
+
+llvm::Error ModuleTemplate::save(llvm::StringRef Path) const
+{
+  std::error_code EC;
+  llvm::raw_fd_ostream OS{Path, EC};
+  if (EC)
+    return llvm::errorCodeToError(EC);
+  OS.write(Bitcode.data(), Bitcode.size());
+  OS.close();
+  if (OS.has_error()) {
+    EC = OS.error();
+    OS.clear_error();
+    return llvm::errorCodeToError(EC);
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<std::unique_ptr<llvm::Module>>
+ModuleTemplate::instantiate(llvm::LLVMContext &C,
+                            llvm::ArrayRef<Param> Params) const
+{
+  std::unique_ptr<llvm::Module> Copy;
+
+  if (&C == &M->getContext())
+    Copy = llvm::CloneModule(*M);
+  else {
+    llvm::Expected<std::unique_ptr<llvm::Module>> Parsed
+      {llvm::parseBitcodeFile
+       (llvm::MemoryBufferRef{llvm::StringRef{Bitcode.data(), Bitcode.size()},
+                              M->getModuleIdentifier()}, C)};
+    if (!Parsed)
+      return Parsed.takeError();
+    Copy = std::move(*Parsed);
+  }
+
+  for (const Param &P : Params) {
+    llvm::GlobalVariable *GV = Copy->getNamedGlobal(P.first);
+    if (!GV)
+      return llvm::make_error<llvm::StringError>
+        ("no such parameter: " + P.first, llvm::inconvertibleErrorCode());
+    if (GV->getValueType() != P.second->getType())
+      return llvm::make_error<llvm::StringError>
+        ("type mismatch for parameter " + P.first,
+         llvm::inconvertibleErrorCode());
+    GV->setInitializer(P.second);
+  }
+
+  return Copy;
+}
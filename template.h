@@ -0,0 +1,45 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+
+/** A parameterized module that is built or loaded once and then copied
+for each compilation, instead of being constructed by llvm::IRBuilder
+every time. The parameters are global variables, whose initializers are
+replaced in each copy. When a parameter is a constant global variable,
+the optimizer will propagate its value into the code. */
+class ModuleTemplate
+{
+public:
+  /** A parameter value: the name of a global variable in the template,
+  and its initializer, which must be of the same type */
+  using Param = std::pair<llvm::StringRef, llvm::Constant*>;
+
+  explicit ModuleTemplate(std::unique_ptr<llvm::Module> M);
+
+  /** Load a template from a bitcode file. */
+  static llvm::Expected<std::unique_ptr<ModuleTemplate>>
+  load(llvm::StringRef Path, llvm::LLVMContext &C);
+
+  /** Write the template to a bitcode file. */
+  llvm::Error save(llvm::StringRef Path) const;
+
+  /** Create a copy of the template with some initializers replaced.
+  Within the context of the template, the module will be cloned;
+  for any other context, the module will be parsed from bitcode.
+  @param C       the context of the copy
+  @param Params  replacement initializers, in the context C */
+  llvm::Expected<std::unique_ptr<llvm::Module>>
+  instantiate(llvm::LLVMContext &C, llvm::ArrayRef<Param> Params = {}) const;
+
+  const llvm::Module &getModule() const { return *M; }
+
+private:
+  std::unique_ptr<llvm::Module> M;
+  /** the bitcode of M */
+  llvm::SmallVector<char, 0> Bitcode;
+};
+#endif
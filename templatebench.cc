@@ -0,0 +1,143 @@
+/* Compare the time to construct a module with IRBuilder against
+instantiating it from a ModuleTemplate, with the initializer of
+"greetings" being replaced for each module. */
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "template.h"
+
+#include <chrono>
+#include <cstdio> /* printf(), snprintf() */
+#include <cstdlib> /* atoi() */
+
+#if defined __GNUC__ && !defined __clang__ && __GNUC__ == 4
+namespace std { using llvm::make_unique; }
+#endif
+
+#if LLVM_VERSION_MAJOR < 10
+namespace llvm { using Align = int; }
+#endif
+
+/** @return the initializer of greetings */
+static llvm::Constant *createGreetings(llvm::LLVMContext &C, unsigned i)
+{
+  char world[6], all[6];
+  snprintf(world, sizeof world, "w%04u", i % 10000);
+  snprintf(all, sizeof all, "a%04u", i % 10000);
+  const auto w =
+    llvm::ConstantDataArray::getString(C, llvm::StringRef{world, 6}, false);
+  const auto a =
+    llvm::ConstantDataArray::getString(C, llvm::StringRef{all, 6}, false);
+  return llvm::ConstantArray::get(llvm::ArrayType::get(w->getType(), 2),
+                                  {w, a});
+}
+
+/** Construct the module of llo-orc.cc, with n copies of the function */
+static std::unique_ptr<llvm::Module> createModule(llvm::LLVMContext &C,
+                                                  unsigned i, unsigned n)
+{
+  auto M = std::make_unique<llvm::Module>("heLLoVM", C);
+  const auto stringType = llvm::Type::getInt8PtrTy(C);
+  const auto intType = llvm::Type::getInt32Ty(C);
+  llvm::FunctionType *PutsType =
+    llvm::FunctionType::get(intType, {stringType}, false);
+  llvm::FunctionType *FT =
+    llvm::FunctionType::get(intType,
+                            {stringType, PutsType->getPointerTo(), intType},
+                            false);
+
+  const auto greetings = createGreetings(C, i);
+  auto GV = new llvm::GlobalVariable(*M, greetings->getType(), true,
+                                     llvm::GlobalValue::ExternalLinkage,
+                                     greetings, "greetings");
+  GV->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Local);
+  GV->setAlignment(llvm::Align(1));
+  GV->setSection(llvm::StringRef{".text", 5});
+
+  for (unsigned f = 0; f < n; f++) {
+    llvm::Function *TheFunction =
+      llvm::Function::Create(FT, llvm::Function::ExternalLinkage,
+                             f ? "boo" + std::to_string(f) : "boo", M.get());
+    TheFunction->setDoesNotThrow();
+
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(C, "entry",
+                                                       TheFunction));
+    auto Str = TheFunction->arg_begin();
+    auto F = Str;
+    llvm::FunctionCallee FC{PutsType, ++F};
+    auto c1 = builder.CreateCall(FC, Str);
+    auto c2a = builder.CreateInBoundsGEP(GV->getValueType(), GV,
+                                         {builder.getInt32(0), ++F});
+    auto c2 = builder.CreateCall(FC, builder.CreateBitCast(c2a, stringType));
+    builder.CreateRet(builder.CreateAdd(c1, c2));
+  }
+  return M;
+}
+
+int main(int argc, char **argv)
+{
+  int count = argc > 1 ? atoi(argv[1]) : 10000;
+  unsigned n = argc > 2 ? atoi(argv[2]) : 1;
+  const char *path = argc > 3 ? argv[3] : "template.bc";
+
+  llvm::LLVMContext C;
+  std::unique_ptr<ModuleTemplate> T;
+
+  {
+    /* Round-trip the template through a bitcode file. */
+    llvm::LLVMContext TC;
+    if (llvm::Error Err{ModuleTemplate{createModule(TC, 0, n)}.save(path)}) {
+      llvm::errs() << Err << '\n';
+      return 1;
+    }
+  }
+  if (auto Loaded = ModuleTemplate::load(path, C))
+    T = std::move(*Loaded);
+  else {
+    llvm::errs() << Loaded.takeError() << '\n';
+    return 1;
+  }
+
+  using clock = std::chrono::steady_clock;
+  double us[4] = {0, 0, 0, 0};
+
+  for (int i = 0; i < count; i++) {
+    auto start = clock::now();
+    createModule(C, i, n);
+    auto t1 = clock::now();
+    auto M = T->instantiate(C, {{"greetings", createGreetings(C, i)}});
+    if (!M) {
+      llvm::errs() << M.takeError() << '\n';
+      return 1;
+    }
+    M->reset();
+    auto t2 = clock::now();
+    {
+      llvm::LLVMContext NC;
+      createModule(NC, i, n);
+    }
+    auto t3 = clock::now();
+    {
+      llvm::LLVMContext NC;
+      auto NM = T->instantiate(NC, {{"greetings", createGreetings(NC, i)}});
+      if (!NM) {
+        llvm::errs() << NM.takeError() << '\n';
+        return 1;
+      }
+    }
+    auto t4 = clock::now();
+
+    using us_t = std::chrono::duration<double, std::micro>;
+    us[0] += us_t(t1 - start).count();
+    us[1] += us_t(t2 - t1).count();
+    us[2] += us_t(t3 - t2).count();
+    us[3] += us_t(t4 - t3).count();
+  }
+
+  printf("functions\tbuild_us\tclone_us\tbuild_newctx_us\t"
+         "bitcode_newctx_us\n");
+  printf("%u\t%.2f\t%.2f\t%.2f\t%.2f\n", n, us[0] / count, us[1] / count,
+         us[2] / count, us[3] / count);
+  return 0;
+}